@@ -0,0 +1,118 @@
+#include "weatherBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "weatherParser.h"
+
+using namespace Weather;
+
+namespace {
+
+int openAndPrefetch(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+    return fd;
+}
+
+bool readWholeFile(int fd, std::string& buffer)
+{
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0) {
+        return false;
+    }
+
+    buffer.resize(static_cast<size_t>(fileStat.st_size));
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+        auto bytes = ::pread(fd, &buffer[offset], buffer.size() - offset, static_cast<off_t>(offset));
+        if (bytes < 0) {
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        offset += static_cast<size_t>(bytes);
+    }
+    buffer.resize(offset);
+    return true;
+}
+
+}  // namespace
+
+WeatherBatch::WeatherBatch(unsigned workerCount)
+    : workerCount_(workerCount != 0 ? workerCount : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+WeatherBatchResult WeatherBatch::run(const std::vector<std::string>& paths) const
+{
+    WeatherBatchResult result;
+    result.files.resize(paths.size());
+
+    auto workerCount = std::min<size_t>(workerCount_, paths.size());
+    std::atomic<size_t> nextFile{0};
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (size_t worker = 0; worker < workerCount; worker++) {
+        workers.emplace_back([this, &paths, &result, &nextFile]() { runWorker(paths, result, nextFile); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t index = 0; index < result.files.size(); index++) {
+        const auto& file = result.files[index];
+        if (file.isRead && !file.isFailed && file.day != -1 && file.spread < result.bestSpread) {
+            result.bestFileIndex = static_cast<int>(index);
+            result.bestDay = file.day;
+            result.bestSpread = file.spread;
+        }
+    }
+    return result;
+}
+
+void WeatherBatch::runWorker(
+    const std::vector<std::string>& paths, WeatherBatchResult& result, std::atomic<size_t>& nextFile) const
+{
+    std::string buffer;
+    auto current = nextFile++;
+    int currentFd = current < paths.size() ? openAndPrefetch(paths[current]) : -1;
+
+    while (current < paths.size()) {
+        auto upcoming = nextFile++;
+        int upcomingFd = upcoming < paths.size() ? openAndPrefetch(paths[upcoming]) : -1;
+
+        auto& file = result.files[current];
+        file.path = paths[current];
+        if (currentFd >= 0) {
+            file.isRead = readWholeFile(currentFd, buffer);
+            ::close(currentFd);
+        }
+        if (file.isRead) {
+            // a malformed file must not take the other files of the batch down with it
+            try {
+                WeatherParser parser;
+                file.day = parser.getSmallestTempSpreadDay(buffer);
+                file.spread = parser.getSmallestTempSpread();
+            } catch (const std::exception& error) {
+                file.isFailed = true;
+                file.error = error.what();
+                file.day = -1;
+                file.spread = std::numeric_limits<int>::max();
+            }
+        }
+
+        current = upcoming;
+        currentFd = upcomingFd;
+    }
+}
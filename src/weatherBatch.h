@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace Weather {
+
+struct WeatherFileResult {
+    std::string path;
+    bool isRead = false;
+    // set when the file was read but could not be parsed, error holds the reason
+    bool isFailed = false;
+    std::string error;
+    int day = -1;
+    int spread = std::numeric_limits<int>::max();
+};
+
+struct WeatherBatchResult {
+    std::vector<WeatherFileResult> files;
+    int bestFileIndex = -1;
+    int bestDay = -1;
+    int bestSpread = std::numeric_limits<int>::max();
+};
+
+// Runs the smallest spread computation over many station files. Each worker reads
+// its file with pread while the kernel is already prefetching the next one it claimed.
+class WeatherBatch {
+public:
+    explicit WeatherBatch(unsigned workerCount = 0);
+
+    WeatherBatchResult run(const std::vector<std::string>& paths) const;
+
+private:
+    void runWorker(
+        const std::vector<std::string>& paths, WeatherBatchResult& result, std::atomic<size_t>& nextFile) const;
+
+    unsigned workerCount_;
+};
+
+}  // namespace Weather
@@ -0,0 +1,169 @@
+#include "weatherCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Weather;
+
+static const char SIDECAR_MAGIC[4] = {'W', 'X', 'C', 'C'};
+
+WeatherCache::WeatherCache(const std::string& sourceFile)
+    : sourceFile_(sourceFile), sidecarFile_(getSidecarPath(sourceFile))
+{
+}
+
+WeatherCache::~WeatherCache()
+{
+    unmap();
+}
+
+std::string WeatherCache::getSidecarPath(const std::string& sourceFile)
+{
+    return sourceFile + ".cache";
+}
+
+bool WeatherCache::getSourceStat(const std::string& sourceFile, SourceStat& sourceStat)
+{
+    struct stat fileStat;
+    if (::stat(sourceFile.c_str(), &fileStat) != 0) {
+        return false;
+    }
+    sourceStat.size = static_cast<uint64_t>(fileStat.st_size);
+    sourceStat.mtimeNs = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+    sourceStat.device = static_cast<uint64_t>(fileStat.st_dev);
+    sourceStat.inode = static_cast<uint64_t>(fileStat.st_ino);
+    return true;
+}
+
+bool WeatherCache::load()
+{
+    unmap();
+
+    SourceStat sourceStat;
+    if (!getSourceStat(sourceFile_, sourceStat)) {
+        return false;
+    }
+
+    int fd = ::open(sidecarFile_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat sidecarStat;
+    if (::fstat(fd, &sidecarStat) != 0 || static_cast<size_t>(sidecarStat.st_size) < sizeof(SidecarHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    auto size = static_cast<size_t>(sidecarStat.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const auto* header = static_cast<const SidecarHeader*>(mapping);
+    bool valid = std::memcmp(header->magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) == 0 &&
+                 header->version == VERSION && header->sourceSize == sourceStat.size &&
+                 header->sourceMtimeNs == sourceStat.mtimeNs &&
+                 header->rowCount <= (size - sizeof(SidecarHeader)) / (3 * sizeof(int32_t)) &&
+                 size == sizeof(SidecarHeader) + 3 * header->rowCount * sizeof(int32_t);
+    if (!valid) {
+        ::munmap(mapping, size);
+        return false;
+    }
+
+    mapping_ = mapping;
+    mappingSize_ = size;
+    return true;
+}
+
+bool WeatherCache::store(const WeatherColumns& columns, const SourceStat& sourceStat) const
+{
+    SidecarHeader header{};
+    std::memcpy(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+    header.version = VERSION;
+    header.rowCount = columns.dayNumber.size();
+    header.sourceSize = sourceStat.size;
+    header.sourceMtimeNs = sourceStat.mtimeNs;
+
+    // write to a temporary file of this writer and rename it, so readers never see a partial
+    // sidecar and concurrent writers never write into the same file
+    std::string tmpFile = sidecarFile_ + ".XXXXXX";
+    int fd = ::mkstemp(&tmpFile[0]);
+    if (fd < 0) {
+        return false;
+    }
+
+    auto writeAll = [fd](const void* data, size_t size) {
+        const auto* pos = static_cast<const char*>(data);
+        while (size > 0) {
+            auto written = ::write(fd, pos, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            pos += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    };
+    auto columnBytes = header.rowCount * sizeof(int32_t);
+    // mkstemp creates the file readable by the owner only
+    bool written = ::fchmod(fd, 0644) == 0 && writeAll(&header, sizeof(header)) &&
+                   writeAll(columns.dayNumber.data(), columnBytes) &&
+                   writeAll(columns.minTemperature.data(), columnBytes) &&
+                   writeAll(columns.maxTemperature.data(), columnBytes);
+    if (::close(fd) != 0 || !written) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+
+    if (std::rename(tmpFile.c_str(), sidecarFile_.c_str()) != 0) {
+        std::remove(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t WeatherCache::getRowCount() const
+{
+    return isLoaded() ? static_cast<const SidecarHeader*>(mapping_)->rowCount : 0;
+}
+
+uint64_t WeatherCache::getSourceSize() const
+{
+    return isLoaded() ? static_cast<const SidecarHeader*>(mapping_)->sourceSize : 0;
+}
+
+const int32_t* WeatherCache::getDayNumbers() const
+{
+    return reinterpret_cast<const int32_t*>(static_cast<const char*>(mapping_) + sizeof(SidecarHeader));
+}
+
+const int32_t* WeatherCache::getMinTemperatures() const
+{
+    return getDayNumbers() + getRowCount();
+}
+
+const int32_t* WeatherCache::getMaxTemperatures() const
+{
+    return getMinTemperatures() + getRowCount();
+}
+
+void WeatherCache::unmap()
+{
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mappingSize_);
+        mapping_ = nullptr;
+        mappingSize_ = 0;
+    }
+}
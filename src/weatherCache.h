@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Weather {
+
+struct WeatherColumns {
+    void push_back(int day, int min, int max)
+    {
+        dayNumber.push_back(day);
+        minTemperature.push_back(min);
+        maxTemperature.push_back(max);
+    }
+
+    std::vector<int32_t> dayNumber;
+    std::vector<int32_t> minTemperature;
+    std::vector<int32_t> maxTemperature;
+};
+
+// Binary sidecar stored next to a weather data file as "<file>.cache".
+// Layout: SidecarHeader followed by the day, min and max columns as int32 arrays.
+// A sidecar is only stored for a source whose header and data lines are all complete, so
+// following the source continues right after sourceSize.
+class WeatherCache {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    struct SidecarHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceMtimeNs;
+        uint64_t rowCount;
+    };
+
+    // identifies the source content a sidecar is built from
+    struct SourceStat {
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        uint64_t device = 0;
+        uint64_t inode = 0;
+    };
+
+    explicit WeatherCache(const std::string& sourceFile);
+    ~WeatherCache();
+
+    WeatherCache(const WeatherCache&) = delete;
+    WeatherCache& operator=(const WeatherCache&) = delete;
+
+    static std::string getSidecarPath(const std::string& sourceFile);
+
+    bool load();
+
+    static bool getSourceStat(const std::string& sourceFile, SourceStat& sourceStat);
+
+    // sourceStat must be taken before the source is parsed, so later appends make the sidecar stale
+    bool store(const WeatherColumns& columns, const SourceStat& sourceStat) const;
+
+    bool isLoaded() const
+    {
+        return mapping_ != nullptr;
+    }
+
+    size_t getRowCount() const;
+
+    uint64_t getSourceSize() const;
+
+    const int32_t* getDayNumbers() const;
+    const int32_t* getMinTemperatures() const;
+    const int32_t* getMaxTemperatures() const;
+
+private:
+    void unmap();
+
+    std::string sourceFile_;
+    std::string sidecarFile_;
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+};
+
+}  // namespace Weather
@@ -1,7 +1,40 @@
 #include "weatherParser.h"
 
+#include "weatherScanner.h"
+
+#include <cctype>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace Weather;
 
+#ifdef WEATHER_PARSER_STATS
+namespace {
+
+RejectReason getRejectReason(const char* begin, const char* end)
+{
+    auto first = std::find_if(begin, end, [](char c) { return !std::isspace(static_cast<unsigned char>(c)); });
+    if (first == end) {
+        return RejectReason::BLANK;
+    }
+    return std::isdigit(static_cast<unsigned char>(*first)) ? RejectReason::MALFORMED : RejectReason::NOT_NUMERIC;
+}
+
+}  // namespace
+#endif
+
+void FileDescriptor::reset(int fd)
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+}
+
 int WeatherParser::getDataFromMatchGroup(const std::ssub_match& group) const
 {
     return std::stoi(group.str());
@@ -20,36 +53,300 @@ WeatherDataOfDay WeatherParser::getWeatherDataFromLine(const std::string& lineCo
 
 int WeatherParser::getSmallestTempSpreadDay()
 {
+    if (useSidecarCache_ && loadFromSidecarCache()) {
+        return getSmallestDay();
+    }
+
     if (!isFileOpen()) {
         return -1;
     }
 
+    // the sidecar must describe exactly the parsed bytes of the opened file, so the source is
+    // measured before parsing and the parse stops at the measured size
+    WeatherCache::SourceStat sourceStat;
+    bool storeSidecar = useSidecarCache_ && WeatherCache::getSourceStat(filename_, sourceStat) &&
+                        sourceStat.device == fileDevice_ && sourceStat.inode == fileInode_;
+
     skipFirstTwoLines();
-    processDataLines();
+    collectColumns_ = useSidecarCache_;
+    {
+        WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::PARSE));
+        processDataLines(storeSidecar ? static_cast<std::streamoff>(sourceStat.size) : -1);
+    }
+    collectColumns_ = false;
 
+    // the sidecar holds complete lines only, follow mode resumes after them when it is loaded
+    if (storeSidecar && followOffset_ == static_cast<std::streamoff>(sourceStat.size) && headerLinesToSkip_ == 0 &&
+        partialLine_.empty()) {
+        WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::REDUCE));
+        WeatherCache(filename_).store(parsedColumns_, sourceStat);
+    }
+    parsedColumns_ = {};
+
+    return getSmallestDay();
+}
+
+int WeatherParser::getSmallestTempSpreadDay(std::string_view content)
+{
+    WEATHER_STATS(stats_.addBytesRead(content.size()));
+    {
+        WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::HEADER_SKIP));
+        for (int headerLine = 0; headerLine < 2 && !content.empty(); headerLine++) {
+            auto lineEnd = content.find('\n');
+            content.remove_prefix(lineEnd == std::string_view::npos ? content.size() : lineEnd + 1);
+        }
+    }
+
+    WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::PARSE));
+    processDataBuffer(content);
     return minDay;
 }
 
+bool WeatherParser::loadFromSidecarCache()
+{
+    WeatherCache cache(filename_);
+    if (!cache.load()) {
+        return false;
+    }
+
+    WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::REDUCE));
+    const auto* days = cache.getDayNumbers();
+    const auto* minTemperatures = cache.getMinTemperatures();
+    const auto* maxTemperatures = cache.getMaxTemperatures();
+    for (size_t row = 0; row < cache.getRowCount(); row++) {
+        updateSmallestSpread(_WeatherDataOfDay(days[row], minTemperatures[row], maxTemperatures[row]));
+    }
+
+    // the sidecar covers the header and all complete lines of the source
+    followOffset_ = static_cast<std::streamoff>(cache.getSourceSize());
+    partialLine_.clear();
+    headerLinesToSkip_ = 0;
+    fileHandle_.clear();
+    fileHandle_.seekg(followOffset_);
+    return true;
+}
+
 void WeatherParser::skipFirstTwoLines()
 {
+    WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::HEADER_SKIP));
     std::string _;
-    std::getline(fileHandle_, _);
-    std::getline(fileHandle_, _);
+    while (headerLinesToSkip_ > 0 && std::getline(fileHandle_, _)) {
+        if (fileHandle_.eof()) {
+            // an unfinished header line, follow mode completes it
+            WEATHER_STATS(stats_.addBytesRead(_.size()));
+            followOffset_ += _.size();
+            partialLine_ = _;
+            break;
+        }
+        WEATHER_STATS(stats_.addBytesRead(_.size() + 1));
+        followOffset_ += _.size() + 1;
+        headerLinesToSkip_--;
+    }
+}
+
+void WeatherParser::processDataLines(std::streamoff dataLimit)
+{
+    auto dataStart = fileHandle_.tellg();
+    fileHandle_.seekg(0, std::ios_base::end);
+    auto dataEnd = fileHandle_.tellg();
+    if (dataLimit >= 0 && dataEnd > dataLimit) {
+        dataEnd = dataLimit;
+    }
+    if (dataStart < 0 || dataEnd < dataStart) {
+        return;
+    }
+
+    std::string data(static_cast<size_t>(dataEnd - dataStart), '\0');
+    fileHandle_.seekg(dataStart);
+    fileHandle_.read(&data[0], static_cast<std::streamsize>(data.size()));
+    data.resize(static_cast<size_t>(fileHandle_.gcount()));
+    WEATHER_STATS(stats_.addBytesRead(data.size()));
+
+    // follow mode continues after the parsed bytes. An unfinished last line may still grow, so it
+    // only yields a provisional record until follow mode sees its newline
+    followOffset_ = dataStart + static_cast<std::streamoff>(data.size());
+    auto lastNewline = data.rfind('\n');
+    auto completeSize = lastNewline == std::string::npos ? 0 : lastNewline + 1;
+    partialLine_ = data.substr(completeSize);
+
+    processDataBuffer(std::string_view(data).substr(0, completeSize));
+    if (!partialLine_.empty()) {
+        provisionalTail_ = getWeatherDataFromLine(partialLine_);
+    }
 }
 
-void WeatherParser::processDataLines()
+void WeatherParser::processDataBuffer(std::string_view data)
 {
+    const char* cursor = data.data();
+    const char* end = data.data() + data.size();
     std::string line;
-    while (std::getline(fileHandle_, line)) {
-        auto weatherData = getWeatherDataFromLine(line);
-        if (weatherData.has_value()) {
-            auto spread = getTemperatureSpread(weatherData);
-            if (spread < minSpread) {
-                minDay = (*weatherData).dayNumber;
-                minSpread = spread;
+    while (cursor < end) {
+        WEATHER_STATS(auto sample = stats_.sampleLine());
+        const char* lineEnd = WeatherScanner::findLineTerminator(cursor, end);
+        int fields[3];
+        auto result = WeatherScanner::FieldsResult::UNDECIDED;
+        if (lineEnd == end || *lineEnd == '\n') {
+            result = WeatherScanner::parseLeadingFields(cursor, lineEnd, end, fields);
+        } else {
+            // a '\r' inside the line, weatherDataRegex decides how it is treated
+            auto newline = std::memchr(lineEnd, '\n', static_cast<size_t>(end - lineEnd));
+            lineEnd = newline != nullptr ? static_cast<const char*>(newline) : end;
+        }
+
+        if (result == WeatherScanner::FieldsResult::PARSED) {
+            recordWeatherData(_WeatherDataOfDay(fields[0], fields[1], fields[2]));
+        } else if (result == WeatherScanner::FieldsResult::UNDECIDED) {
+            line.assign(cursor, lineEnd);
+            auto weatherData = getWeatherDataFromLine(line);
+            if (weatherData.has_value()) {
+                recordWeatherData(weatherData);
+            } else {
+                WEATHER_STATS(stats_.addLineRejected(getRejectReason(cursor, lineEnd)));
             }
+        } else {
+            WEATHER_STATS(stats_.addLineRejected(getRejectReason(cursor, lineEnd)));
+        }
+
+        cursor = lineEnd == end ? end : lineEnd + 1;
+    }
+}
+
+void WeatherParser::recordWeatherData(const WeatherDataOfDay& data)
+{
+    WEATHER_STATS(stats_.addLineParsed());
+    if (collectColumns_) {
+        parsedColumns_.push_back((*data).dayNumber, (*data).minTemperature, (*data).maxTemperature);
+    }
+    updateSmallestSpread(data);
+}
+
+void WeatherParser::updateSmallestSpread(const WeatherDataOfDay& data)
+{
+    auto spread = getTemperatureSpread(data);
+    if (spread < minSpread) {
+        minDay = (*data).dayNumber;
+        minSpread = spread;
+        if (spreadChangedCallback_) {
+            spreadChangedCallback_(minDay, minSpread);
+        }
+    }
+}
+
+int WeatherParser::pollAppendedData()
+{
+    if (!isFileOpen()) {
+        return -1;
+    }
+
+    struct stat fileStat;
+    if (::stat(filename_.c_str(), &fileStat) == 0 &&
+        (static_cast<uint64_t>(fileStat.st_dev) != fileDevice_ || static_cast<uint64_t>(fileStat.st_ino) != fileInode_ ||
+         fileStat.st_size < followOffset_)) {
+        restartFollow();
+        if (!isFileOpen()) {
+            return -1;
+        }
+    }
+
+    fileHandle_.clear();
+    fileHandle_.seekg(followOffset_);
+
+    std::string line;
+    while (std::getline(fileHandle_, line)) {
+        WEATHER_STATS(stats_.addBytesRead(line.size() + (fileHandle_.eof() ? 0 : 1)));
+        if (fileHandle_.eof()) {
+            // the writer has not finished this line yet, keep it until its newline arrives
+            followOffset_ += line.size();
+            partialLine_ += line;
+            break;
+        }
+
+        followOffset_ += line.size() + 1;
+        if (partialLine_.empty()) {
+            processFollowedLine(line);
+        } else {
+            partialLine_ += line;
+            provisionalTail_.reset();
+            processFollowedLine(partialLine_);
+            partialLine_.clear();
+        }
+    }
+
+    return getSmallestDay();
+}
+
+void WeatherParser::processFollowedLine(const std::string& line)
+{
+    if (headerLinesToSkip_ > 0) {
+        headerLinesToSkip_--;
+        return;
+    }
+
+    processDataBuffer(line);
+}
+
+void WeatherParser::recordFileIdentity()
+{
+    struct stat fileStat;
+    if (isFileOpen() && ::stat(filename_.c_str(), &fileStat) == 0) {
+        fileDevice_ = static_cast<uint64_t>(fileStat.st_dev);
+        fileInode_ = static_cast<uint64_t>(fileStat.st_ino);
+    }
+}
+
+void WeatherParser::restartFollow()
+{
+    fileHandle_.close();
+    fileHandle_.clear();
+    fileHandle_.open(filename_, std::ios_base::in);
+    recordFileIdentity();
+    // the watch belongs to the old file
+    inotifyFd_.reset();
+
+    followOffset_ = 0;
+    partialLine_.clear();
+    provisionalTail_.reset();
+    headerLinesToSkip_ = 2;
+    minSpread = std::numeric_limits<int>::max();
+    minDay = -1;
+}
+
+bool WeatherParser::waitForAppend(int timeoutMs)
+{
+    if (inotifyFd_.get() < 0) {
+        FileDescriptor inotifyFd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+        if (inotifyFd.get() < 0 || ::inotify_add_watch(inotifyFd.get(), filename_.c_str(), IN_MODIFY) < 0) {
+            return false;
         }
+        inotifyFd_ = std::move(inotifyFd);
+    }
+
+    // data may have been appended before the watch was armed, or the file shrank or was replaced
+    struct stat fileStat;
+    if (::stat(filename_.c_str(), &fileStat) == 0 &&
+        (fileStat.st_size != followOffset_ || static_cast<uint64_t>(fileStat.st_ino) != fileInode_)) {
+        return true;
+    }
+
+    pollfd pollFd{inotifyFd_.get(), POLLIN, 0};
+    if (::poll(&pollFd, 1, timeoutMs) <= 0) {
+        return false;
+    }
+
+    char events[4096];
+    while (::read(inotifyFd_.get(), events, sizeof(events)) > 0) {
     }
+    return true;
+}
+
+bool WeatherParser::isProvisionalTailSmallest() const
+{
+    return provisionalTail_.has_value() && getTemperatureSpread(provisionalTail_) < minSpread;
+}
+
+int WeatherParser::getSmallestDay() const
+{
+    return isProvisionalTailSmallest() ? (*provisionalTail_).dayNumber : minDay;
 }
 
 int WeatherParser::getTemperatureSpread(const WeatherDataOfDay& data) const
@@ -1,8 +1,15 @@
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <regex>
+#include <string_view>
+#include <utility>
+
+#include "weatherCache.h"
+#include "weatherStats.h"
 
 namespace Weather {
 
@@ -18,11 +25,47 @@ struct _WeatherDataOfDay {
 };
 using WeatherDataOfDay = std::optional<_WeatherDataOfDay>;
 
+// owns a file descriptor and closes it, moving transfers the ownership
+class FileDescriptor {
+public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd) : fd_(fd) {}
+    FileDescriptor(FileDescriptor&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept
+    {
+        if (this != &other) {
+            reset(std::exchange(other.fd_, -1));
+        }
+        return *this;
+    }
+    ~FileDescriptor()
+    {
+        reset();
+    }
+
+    int get() const
+    {
+        return fd_;
+    }
+
+    void reset(int fd = -1);
+
+private:
+    int fd_ = -1;
+};
+
 class WeatherParser {
 public:
-    WeatherParser() = default;
-    explicit WeatherParser(const std::string& filename) : fileHandle_(filename, std::ios_base::in) {}
+    using SpreadChangedCallback = std::function<void(int day, int spread)>;
 
+    WeatherParser() = default;
+    explicit WeatherParser(const std::string& filename, bool useSidecarCache = false)
+        : filename_(filename), useSidecarCache_(useSidecarCache)
+    {
+        WEATHER_STATS(ParserStats::PhaseTimer timer(stats_, ParsePhase::OPEN));
+        fileHandle_.open(filename, std::ios_base::in);
+        recordFileIdentity();
+    }
     bool isFileOpen()
     {
         return fileHandle_.is_open();
@@ -30,6 +73,30 @@ public:
 
     int getSmallestTempSpreadDay();
 
+    // parse the whole content of a weather data file that is already in memory
+    int getSmallestTempSpreadDay(std::string_view content);
+
+    int getSmallestTempSpread() const
+    {
+        return isProvisionalTailSmallest() ? getTemperatureSpread(provisionalTail_) : minSpread;
+    }
+
+    // follow mode: parse only the bytes appended since the previous call or since a full parse;
+    // a truncated or replaced file is followed again from its start
+    int pollAppendedData();
+
+    bool waitForAppend(int timeoutMs);
+
+    void setSpreadChangedCallback(SpreadChangedCallback callback)
+    {
+        spreadChangedCallback_ = std::move(callback);
+    }
+
+    const ParserStats& getStats() const
+    {
+        return stats_;
+    }
+
     WeatherDataOfDay getWeatherDataFromLine(const std::string& lineContent) const;
 
     int getDataFromMatchGroup(const std::ssub_match& group) const;
@@ -39,11 +106,49 @@ private:
 
     void skipFirstTwoLines();
 
-    void processDataLines();
+    // reads the data lines up to dataLimit bytes into the file, or to its end when dataLimit < 0
+    void processDataLines(std::streamoff dataLimit = -1);
+
+    void processDataBuffer(std::string_view data);
+
+    void recordWeatherData(const WeatherDataOfDay& data);
+
+    void updateSmallestSpread(const WeatherDataOfDay& data);
+
+    bool loadFromSidecarCache();
+
+    void processFollowedLine(const std::string& line);
+
+    void recordFileIdentity();
+
+    void restartFollow();
+
+    bool isProvisionalTailSmallest() const;
+
+    // the smallest spread day of the complete lines and the provisional tail
+    int getSmallestDay() const;
 
     int minSpread = std::numeric_limits<int>::max();
     int minDay = -1;
+    std::string filename_;
+    bool useSidecarCache_ = false;
+    // records of a full parse, only collected while a sidecar is going to be stored
+    WeatherColumns parsedColumns_;
+    bool collectColumns_ = false;
     std::ifstream fileHandle_;
+
+    SpreadChangedCallback spreadChangedCallback_;
+    std::streamoff followOffset_ = 0;
+    std::string partialLine_;
+    // record of an unfinished last line seen by a full parse, replaced once the line is complete
+    WeatherDataOfDay provisionalTail_;
+    int headerLinesToSkip_ = 2;
+    // identity of the followed file, a different one at filename_ means it was rotated
+    uint64_t fileDevice_ = 0;
+    uint64_t fileInode_ = 0;
+    FileDescriptor inotifyFd_;
+
+    ParserStats stats_;
 };
 
 }  // namespace Weather
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "weatherScanner.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WEATHER_SCANNER_X86
+#endif
+
+using namespace Weather;
+
+namespace {
+
+// the digit parser may read up to 8 bytes from a field starting anywhere in the block
+constexpr size_t WINDOW_SIZE = WeatherScanner::BLOCK_SIZE + 8;
+
+constexpr uint32_t MAX_FIELD_DIGITS = 9;
+
+inline unsigned countTrailingZeros(uint64_t mask)
+{
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+}
+
+// length of the run of set bits starting at pos
+inline unsigned runLength(uint32_t mask, unsigned pos)
+{
+    return countTrailingZeros(~(static_cast<uint64_t>(mask) >> pos));
+}
+
+#ifdef WEATHER_SCANNER_X86
+
+uint32_t sse2Mask(__m128i lo, __m128i hi)
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(lo)) | (static_cast<uint32_t>(_mm_movemask_epi8(hi)) << 16);
+}
+
+__m128i sse2InRange(__m128i bytes, char low, char high)
+{
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+        _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+
+__m128i sse2LineTerminator(__m128i bytes)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+}
+
+__m128i sse2Whitespace(__m128i bytes)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), sse2InRange(bytes, '\t', '\r'));
+}
+
+WeatherScanner::ByteMasks classifySse2(const char* block)
+{
+    auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    return {
+        sse2Mask(sse2LineTerminator(lo), sse2LineTerminator(hi)), sse2Mask(sse2Whitespace(lo), sse2Whitespace(hi)),
+        sse2Mask(sse2InRange(lo, '0', '9'), sse2InRange(hi, '0', '9'))};
+}
+
+const char* findLineTerminatorSse2(const char* begin, const char* end)
+{
+    for (; end - begin >= 16; begin += 16) {
+        auto mask = _mm_movemask_epi8(sse2LineTerminator(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin))));
+        if (mask != 0) {
+            return begin + countTrailingZeros(static_cast<uint32_t>(mask));
+        }
+    }
+    for (; begin != end && *begin != '\n' && *begin != '\r'; begin++) {
+    }
+    return begin;
+}
+
+__attribute__((target("avx2"))) __m256i avx2InRange(__m256i bytes, char low, char high)
+{
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(static_cast<char>(low - 1))),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), bytes));
+}
+
+__attribute__((target("avx2"))) __m256i avx2LineTerminator(__m256i bytes)
+{
+    return _mm256_or_si256(
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')));
+}
+
+__attribute__((target("avx2"))) WeatherScanner::ByteMasks classifyAvx2(const char* block)
+{
+    auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    auto whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')), avx2InRange(bytes, '\t', '\r'));
+    return {
+        static_cast<uint32_t>(_mm256_movemask_epi8(avx2LineTerminator(bytes))),
+        static_cast<uint32_t>(_mm256_movemask_epi8(whitespace)),
+        static_cast<uint32_t>(_mm256_movemask_epi8(avx2InRange(bytes, '0', '9')))};
+}
+
+__attribute__((target("avx2"))) const char* findLineTerminatorAvx2(const char* begin, const char* end)
+{
+    for (; end - begin >= 32; begin += 32) {
+        auto mask = _mm256_movemask_epi8(avx2LineTerminator(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin))));
+        if (mask != 0) {
+            return begin + countTrailingZeros(static_cast<uint32_t>(mask));
+        }
+    }
+    return findLineTerminatorSse2(begin, end);
+}
+
+const bool hasAvx2 = __builtin_cpu_supports("avx2");
+
+#else
+
+WeatherScanner::ByteMasks classifyScalar(const char* block)
+{
+    WeatherScanner::ByteMasks masks{0, 0, 0};
+    for (unsigned index = 0; index < WeatherScanner::BLOCK_SIZE; index++) {
+        auto byte = block[index];
+        auto bit = 1u << index;
+        if (byte == '\n' || byte == '\r') {
+            masks.lineTerminator |= bit;
+        }
+        if (byte == ' ' || (byte >= '\t' && byte <= '\r')) {
+            masks.whitespace |= bit;
+        }
+        if (byte >= '0' && byte <= '9') {
+            masks.digit |= bit;
+        }
+    }
+    return masks;
+}
+
+#endif
+
+}  // namespace
+
+const char* WeatherScanner::findLineTerminator(const char* begin, const char* end)
+{
+#ifdef WEATHER_SCANNER_X86
+    return hasAvx2 ? findLineTerminatorAvx2(begin, end) : findLineTerminatorSse2(begin, end);
+#else
+    for (; begin != end && *begin != '\n' && *begin != '\r'; begin++) {
+    }
+    return begin;
+#endif
+}
+
+WeatherScanner::ByteMasks WeatherScanner::classifyBlock(const char* block)
+{
+#ifdef WEATHER_SCANNER_X86
+    return hasAvx2 ? classifyAvx2(block) : classifySse2(block);
+#else
+    return classifyScalar(block);
+#endif
+}
+
+uint32_t WeatherScanner::parseDigits(const char* digits, size_t count)
+{
+    if (count > 8) {
+        uint32_t value = 0;
+        for (size_t index = 0; index < count; index++) {
+            value = value * 10 + static_cast<uint32_t>(digits[index] - '0');
+        }
+        return value;
+    }
+
+    // SWAR: move the digits to the high bytes, then combine pairs, quads and octets
+    uint64_t chunk;
+    std::memcpy(&chunk, digits, sizeof(chunk));
+    chunk -= 0x3030303030303030ull;
+    chunk <<= (8 - count) * 8;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFull;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFull;
+    return static_cast<uint32_t>(chunk);
+}
+
+WeatherScanner::FieldsResult WeatherScanner::parseLeadingFields(
+    const char* begin, const char* lineEnd, const char* bufferEnd, int (&fields)[3])
+{
+    char window[WINDOW_SIZE];
+    const char* block = begin;
+    if (static_cast<size_t>(bufferEnd - begin) < WINDOW_SIZE) {
+        auto available = static_cast<size_t>(bufferEnd - begin);
+        std::memcpy(window, begin, available);
+        std::memset(window + available, '\n', WINDOW_SIZE - available);
+        block = window;
+    }
+
+    auto lineLength = static_cast<size_t>(lineEnd - begin);
+    auto lineMask = lineLength >= BLOCK_SIZE ? ~0u : (1u << lineLength) - 1;
+    auto masks = classifyBlock(block);
+    auto whitespace = masks.whitespace & lineMask;
+    auto digit = masks.digit & lineMask;
+
+    unsigned pos = runLength(whitespace, 0);
+    if (pos >= BLOCK_SIZE) {
+        return lineLength > BLOCK_SIZE ? FieldsResult::UNDECIDED : FieldsResult::REJECTED;
+    }
+    if (pos >= lineLength || ((digit >> pos) & 1) == 0) {
+        return FieldsResult::REJECTED;
+    }
+
+    for (unsigned field = 0; field < 3; field++) {
+        if (field > 0) {
+            auto gap = runLength(whitespace, pos);
+            // "12 3" could still match by splitting digit runs, leave such lines to the regex
+            if (gap == 0 || pos + gap >= BLOCK_SIZE) {
+                return FieldsResult::UNDECIDED;
+            }
+            pos += gap;
+        }
+
+        auto digits = runLength(digit, pos);
+        if (digits == 0 || digits > MAX_FIELD_DIGITS || pos + digits >= BLOCK_SIZE) {
+            return FieldsResult::UNDECIDED;
+        }
+        fields[field] = static_cast<int>(parseDigits(block + pos, digits));
+        pos += digits;
+    }
+    return FieldsResult::PARSED;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Weather {
+
+// Vectorized tokenizer for weather data lines. Bytes are classified 32 at a time into
+// newline, whitespace and digit bitmasks (AVX2 when the CPU has it, SSE2 otherwise).
+class WeatherScanner {
+public:
+    static constexpr size_t BLOCK_SIZE = 32;
+
+    enum class FieldsResult {
+        PARSED,
+        REJECTED,
+        // the line is unusual enough that only weatherDataRegex can decide it
+        UNDECIDED
+    };
+
+    struct ByteMasks {
+        uint32_t lineTerminator;
+        uint32_t whitespace;
+        uint32_t digit;
+    };
+
+    // returns the first '\n' or '\r' in [begin, end), or end
+    static const char* findLineTerminator(const char* begin, const char* end);
+
+    // extracts the three leading whitespace separated integers of the line [begin, lineEnd);
+    // bytes up to bufferEnd may be read but are never interpreted
+    static FieldsResult parseLeadingFields(const char* begin, const char* lineEnd, const char* bufferEnd, int (&fields)[3]);
+
+    static ByteMasks classifyBlock(const char* block);
+
+    static uint32_t parseDigits(const char* digits, size_t count);
+};
+
+}  // namespace Weather
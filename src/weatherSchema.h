@@ -0,0 +1,211 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace Weather {
+
+enum class ColumnType {
+    INT,
+    FLOAT
+};
+
+// A column is either the index-th whitespace delimited field of a line, or width bytes
+// starting at byte offset of a line (fixed width, surrounding spaces are ignored).
+struct ColumnSpec {
+    ColumnType type;
+    size_t index;
+    size_t offset;
+    size_t width;
+
+    constexpr bool isFixedWidth() const
+    {
+        return width != 0;
+    }
+};
+
+constexpr ColumnSpec delimitedColumn(size_t index, ColumnType type)
+{
+    return {type, index, 0, 0};
+}
+
+constexpr ColumnSpec fixedWidthColumn(size_t offset, size_t width, ColumnType type)
+{
+    return {type, 0, offset, width};
+}
+
+// day, max and min temperature of weather.dat
+struct WeatherDatSchema {
+    static constexpr size_t HEADER_LINES = 2;
+    static constexpr std::array<ColumnSpec, 3> COLUMNS = {
+        delimitedColumn(0, ColumnType::INT), delimitedColumn(1, ColumnType::INT), delimitedColumn(2, ColumnType::INT)};
+};
+
+// Line parser generated from a Schema with a static constexpr HEADER_LINES and COLUMNS.
+// Delimited columns must be listed in field order; fields between them are skipped without
+// being converted. A line is rejected when any requested column does not start with a number
+// or an integer column does not fit in an int.
+template <typename Schema>
+class ParserFor {
+public:
+    static constexpr size_t COLUMN_COUNT = Schema::COLUMNS.size();
+
+    template <size_t I>
+    using ColumnValue = std::conditional_t<Schema::COLUMNS[I].type == ColumnType::INT, int, double>;
+
+private:
+    template <size_t... I>
+    static std::tuple<ColumnValue<I>...> makeRecord(std::index_sequence<I...>);
+
+    static constexpr bool hasOrderedFields()
+    {
+        size_t next = 0;
+        for (const auto& column : Schema::COLUMNS) {
+            if (!column.isFixedWidth()) {
+                if (column.index < next) {
+                    return false;
+                }
+                next = column.index + 1;
+            }
+        }
+        return true;
+    }
+
+    static_assert(hasOrderedFields(), "delimited columns must be listed in field order");
+
+public:
+    using Record = decltype(makeRecord(std::make_index_sequence<COLUMN_COUNT>{}));
+
+    static bool parseLine(std::string_view line, Record& record)
+    {
+        Cursor cursor{line.data(), line.data() + line.size(), 0};
+        return parseColumns(line, cursor, record, std::make_index_sequence<COLUMN_COUNT>{});
+    }
+
+    // calls onRecord for every parsed data line after the header, returns the number of records
+    template <typename Callback>
+    static size_t parse(std::string_view content, Callback&& onRecord)
+    {
+        size_t lineNumber = 0;
+        size_t records = 0;
+        Record record{};
+        while (!content.empty()) {
+            auto lineEnd = content.find('\n');
+            auto line = content.substr(0, lineEnd);
+            content.remove_prefix(lineEnd == std::string_view::npos ? content.size() : lineEnd + 1);
+
+            if (lineNumber++ < Schema::HEADER_LINES) {
+                continue;
+            }
+            if (parseLine(line, record)) {
+                onRecord(static_cast<const Record&>(record));
+                records++;
+            }
+        }
+        return records;
+    }
+
+private:
+    struct Cursor {
+        const char* pos;
+        const char* end;
+        // index of the field pos is in front of
+        size_t field;
+    };
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    static bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    template <size_t... I>
+    static bool parseColumns(std::string_view line, Cursor& cursor, Record& record, std::index_sequence<I...>)
+    {
+        return (parseColumn<I>(line, cursor, std::get<I>(record)) && ...);
+    }
+
+    template <size_t I>
+    static bool parseColumn(std::string_view line, Cursor& cursor, ColumnValue<I>& value)
+    {
+        constexpr auto column = Schema::COLUMNS[I];
+        if constexpr (column.isFixedWidth()) {
+            if (line.size() < column.offset) {
+                return false;
+            }
+            auto field = line.substr(column.offset, column.width);
+            const char* pos = field.data();
+            const char* end = pos + field.size();
+            for (; pos != end && *pos == ' '; pos++) {
+            }
+            return parseValue(pos, end, value);
+        } else {
+            for (; cursor.field < column.index; cursor.field++) {
+                for (; cursor.pos != cursor.end && isSpace(*cursor.pos); cursor.pos++) {
+                }
+                for (; cursor.pos != cursor.end && !isSpace(*cursor.pos); cursor.pos++) {
+                }
+            }
+            for (; cursor.pos != cursor.end && isSpace(*cursor.pos); cursor.pos++) {
+            }
+            cursor.field++;
+            if (!parseValue(cursor.pos, cursor.end, value)) {
+                return false;
+            }
+            // the rest of the field, e.g. the '*' marking a monthly extreme, is ignored
+            for (; cursor.pos != cursor.end && !isSpace(*cursor.pos); cursor.pos++) {
+            }
+            return true;
+        }
+    }
+
+    static bool parseValue(const char*& pos, const char* end, int& value)
+    {
+        bool negative = pos != end && *pos == '-';
+        if (negative) {
+            pos++;
+        }
+        if (pos == end || !isDigit(*pos)) {
+            return false;
+        }
+
+        int result = 0;
+        for (; pos != end && isDigit(*pos); pos++) {
+            auto digit = *pos - '0';
+            if (result > (std::numeric_limits<int>::max() - digit) / 10) {
+                return false;
+            }
+            result = result * 10 + digit;
+        }
+        value = negative ? -result : result;
+        return true;
+    }
+
+    // from_chars rounds correctly, the check in front of it keeps out inf, nan and a leading '+'
+    static bool parseValue(const char*& pos, const char* end, double& value)
+    {
+        const char* digits = pos != end && *pos == '-' ? pos + 1 : pos;
+        if (digits == end || !(isDigit(*digits) || (*digits == '.' && digits + 1 != end && isDigit(digits[1])))) {
+            return false;
+        }
+
+        auto result = std::from_chars(pos, end, value, std::chars_format::fixed);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        pos = result.ptr;
+        return true;
+    }
+};
+
+}  // namespace Weather
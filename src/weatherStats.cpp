@@ -0,0 +1,88 @@
+#include "weatherStats.h"
+
+#include <sstream>
+
+using namespace Weather;
+
+namespace {
+
+const char* const REJECT_REASON_NAMES[] = {"blank", "not_numeric", "malformed"};
+const char* const PHASE_NAMES[] = {"open", "header_skip", "parse", "reduce"};
+
+}  // namespace
+
+void ParserStats::addLineLatency(uint64_t ns)
+{
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKETS && (uint64_t{1} << bucket) < ns) {
+        bucket++;
+    }
+    lineLatency_[bucket]++;
+    lineLatencyNs_ += ns;
+}
+
+uint64_t ParserStats::getLinesRejected() const
+{
+    uint64_t total = 0;
+    for (auto count : linesRejected_) {
+        total += count;
+    }
+    return total;
+}
+
+std::string ParserStats::toJson() const
+{
+    std::ostringstream out;
+    out << "{\"enabled\":" << (ENABLED ? "true" : "false") << ",\"bytes_read\":" << bytesRead_
+        << ",\"lines_seen\":" << linesSeen_ << ",\"lines_parsed\":" << linesParsed_ << ",\"lines_rejected\":{";
+    for (size_t reason = 0; reason < linesRejected_.size(); reason++) {
+        out << (reason ? "," : "") << '"' << REJECT_REASON_NAMES[reason] << "\":" << linesRejected_[reason];
+    }
+    out << "},\"phase_ns\":{";
+    for (size_t phase = 0; phase < phaseNs_.size(); phase++) {
+        out << (phase ? "," : "") << '"' << PHASE_NAMES[phase] << "\":" << phaseNs_[phase];
+    }
+    out << "},\"line_latency\":{\"sample_interval\":" << SAMPLE_INTERVAL << ",\"log2_ns_buckets\":[";
+    for (size_t bucket = 0; bucket < lineLatency_.size(); bucket++) {
+        out << (bucket ? "," : "") << lineLatency_[bucket];
+    }
+    out << "],\"sum_ns\":" << lineLatencyNs_ << "}}";
+    return out.str();
+}
+
+std::string ParserStats::toPrometheus() const
+{
+    std::ostringstream out;
+    out << "# TYPE weather_parser_bytes_read_total counter\n";
+    out << "weather_parser_bytes_read_total " << bytesRead_ << '\n';
+    out << "# TYPE weather_parser_lines_seen_total counter\n";
+    out << "weather_parser_lines_seen_total " << linesSeen_ << '\n';
+    out << "# TYPE weather_parser_lines_parsed_total counter\n";
+    out << "weather_parser_lines_parsed_total " << linesParsed_ << '\n';
+    out << "# TYPE weather_parser_lines_rejected_total counter\n";
+    for (size_t reason = 0; reason < linesRejected_.size(); reason++) {
+        out << "weather_parser_lines_rejected_total{reason=\"" << REJECT_REASON_NAMES[reason] << "\"} "
+            << linesRejected_[reason] << '\n';
+    }
+    out << "# TYPE weather_parser_phase_seconds_total counter\n";
+    for (size_t phase = 0; phase < phaseNs_.size(); phase++) {
+        out << "weather_parser_phase_seconds_total{phase=\"" << PHASE_NAMES[phase] << "\"} "
+            << static_cast<double>(phaseNs_[phase]) / 1e9 << '\n';
+    }
+
+    out << "# TYPE weather_parser_line_latency_ns histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket < lineLatency_.size(); bucket++) {
+        cumulative += lineLatency_[bucket];
+        out << "weather_parser_line_latency_ns_bucket{le=\"";
+        if (bucket + 1 < lineLatency_.size()) {
+            out << (uint64_t{1} << bucket);
+        } else {
+            out << "+Inf";
+        }
+        out << "\"} " << cumulative << '\n';
+    }
+    out << "weather_parser_line_latency_ns_sum " << lineLatencyNs_ << '\n';
+    out << "weather_parser_line_latency_ns_count " << cumulative << '\n';
+    return out.str();
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Parser instrumentation is only compiled in with -DWEATHER_PARSER_STATS, otherwise every
+// WEATHER_STATS(...) statement disappears and the counters stay zero.
+#ifdef WEATHER_PARSER_STATS
+#define WEATHER_STATS(statement) statement
+#else
+#define WEATHER_STATS(statement)
+#endif
+
+namespace Weather {
+
+enum class RejectReason { BLANK = 0, NOT_NUMERIC, MALFORMED, COUNT };
+
+enum class ParsePhase { OPEN = 0, HEADER_SKIP, PARSE, REDUCE, COUNT };
+
+class ParserStats {
+public:
+#ifdef WEATHER_PARSER_STATS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+    // one line in SAMPLE_INTERVAL has its parse latency recorded
+    static constexpr uint64_t SAMPLE_INTERVAL = 1024;
+    static constexpr size_t LATENCY_BUCKETS = 32;
+
+    using Clock = std::chrono::steady_clock;
+
+    class PhaseTimer {
+    public:
+        PhaseTimer(ParserStats& stats, ParsePhase phase) : stats_(stats), phase_(phase), start_(Clock::now()) {}
+        ~PhaseTimer()
+        {
+            stats_.addPhaseTime(phase_, elapsedNs(start_));
+        }
+
+    private:
+        ParserStats& stats_;
+        ParsePhase phase_;
+        Clock::time_point start_;
+    };
+
+    class LineSample {
+    public:
+        explicit LineSample(ParserStats* stats) : stats_(stats), start_(stats ? Clock::now() : Clock::time_point{}) {}
+        LineSample(const LineSample&) = delete;
+        ~LineSample()
+        {
+            if (stats_ != nullptr) {
+                stats_->addLineLatency(elapsedNs(start_));
+            }
+        }
+
+    private:
+        ParserStats* stats_;
+        Clock::time_point start_;
+    };
+
+    void addBytesRead(uint64_t bytes)
+    {
+        bytesRead_ += bytes;
+    }
+
+    // counts the line and decides whether its latency is sampled
+    LineSample sampleLine()
+    {
+        return LineSample(linesSeen_++ % SAMPLE_INTERVAL == 0 ? this : nullptr);
+    }
+
+    void addLineParsed()
+    {
+        linesParsed_++;
+    }
+
+    void addLineRejected(RejectReason reason)
+    {
+        linesRejected_[static_cast<size_t>(reason)]++;
+    }
+
+    void addPhaseTime(ParsePhase phase, uint64_t ns)
+    {
+        phaseNs_[static_cast<size_t>(phase)] += ns;
+    }
+
+    void addLineLatency(uint64_t ns);
+
+    uint64_t getBytesRead() const
+    {
+        return bytesRead_;
+    }
+
+    uint64_t getLinesSeen() const
+    {
+        return linesSeen_;
+    }
+
+    uint64_t getLinesParsed() const
+    {
+        return linesParsed_;
+    }
+
+    uint64_t getLinesRejected(RejectReason reason) const
+    {
+        return linesRejected_[static_cast<size_t>(reason)];
+    }
+
+    uint64_t getLinesRejected() const;
+
+    uint64_t getPhaseNs(ParsePhase phase) const
+    {
+        return phaseNs_[static_cast<size_t>(phase)];
+    }
+
+    // bucket i counts sampled lines that took at most 2^i ns and more than 2^(i-1) ns
+    const std::array<uint64_t, LATENCY_BUCKETS>& getLineLatencyHistogram() const
+    {
+        return lineLatency_;
+    }
+
+    // total latency of the sampled lines
+    uint64_t getLineLatencyNs() const
+    {
+        return lineLatencyNs_;
+    }
+
+    std::string toJson() const;
+
+    std::string toPrometheus() const;
+
+private:
+    static uint64_t elapsedNs(Clock::time_point start)
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    uint64_t bytesRead_ = 0;
+    uint64_t linesSeen_ = 0;
+    uint64_t linesParsed_ = 0;
+    std::array<uint64_t, static_cast<size_t>(RejectReason::COUNT)> linesRejected_{};
+    std::array<uint64_t, static_cast<size_t>(ParsePhase::COUNT)> phaseNs_{};
+    std::array<uint64_t, LATENCY_BUCKETS> lineLatency_{};
+    uint64_t lineLatencyNs_ = 0;
+};
+
+}  // namespace Weather
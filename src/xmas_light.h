@@ -1,5 +1,12 @@
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "xmas_light_batch.h"
+#include "xmas_light_index.h"
+#include "xmas_light_stats.h"
 
 constexpr uint LIGHT_NUM = 1000;
 enum class LightState
@@ -11,6 +18,9 @@ enum class LightState
 class LightManager
 {
 public:
+    static constexpr uint GRID_SIZE = LIGHT_NUM;
+    static constexpr uint MAX_LIGHT_LEVEL = 1;
+
     struct Position
     {
         uint x;
@@ -26,6 +36,27 @@ public:
     using LightGrid = std::array<std::array<LightState, LIGHT_NUM>, LIGHT_NUM>;
     using RangeState = std::vector<LightState>;
 
+    enum class Operation
+    {
+        SET = 0,
+        OPEN,
+        CLOSE,
+        SWITCH
+    };
+
+    struct Instruction
+    {
+        Operation operation;
+        Range range;
+        LightState state{LightState::CLOSE};
+    };
+
+    // cells (x * LIGHT_NUM + y) that undoing an instruction has to write back
+    struct UndoRecord
+    {
+        std::vector<std::pair<uint, LightState>> preImage;
+    };
+
     constexpr LightManager() : lightMatrix_({LightState::CLOSE}) {}
 
     LightState getLightState(uint x, uint y) const
@@ -37,7 +68,8 @@ public:
     void setLightState(uint x, uint y, LightState state)
     {
         validateInput(x, y);
-        lightMatrix_[x][y] = state;
+        writeLightState(x, y, state);
+        openLightIndex_.commit(x, y, x, y);
     }
 
     void openLight(uint x, uint y)
@@ -75,6 +107,7 @@ public:
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::GET_RANGE, getRangeSize(start, end)));
 
         RangeState states;
         states.reserve(getRangeSize(start, end));
@@ -94,43 +127,187 @@ public:
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::SET_RANGE, getRangeSize(start, end)));
 
-        iterateRange(start, end, [state, this](uint x, uint y) {
-            setLightState(x, y, state);
-        });
+        writeLightStateWithRange(start, end, state);
     }
 
     void switchLightWithRange(const Position &start, const Position &end)
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::SWITCH_RANGE, getRangeSize(start, end)));
 
         iterateRange(start, end, [this](uint x, uint y) {
-            switchLight(x, y);
+            writeLightState(x, y, lightMatrix_[x][y] == LightState::CLOSE ? LightState::OPEN : LightState::CLOSE);
         });
+        openLightIndex_.commit(start.x, start.y, end.x, end.y);
     }
 
     void openLightWithRange(const Position &start, const Position &end)
     {
-        setLightStateWithRange(start, end, LightState::OPEN);
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::OPEN_RANGE, getRangeSize(start, end)));
+
+        writeLightStateWithRange(start, end, LightState::OPEN);
     }
 
     void closeLightWithRange(const Position &start, const Position &end)
     {
-        setLightStateWithRange(start, end, LightState::CLOSE);
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::CLOSE_RANGE, getRangeSize(start, end)));
+
+        writeLightStateWithRange(start, end, LightState::CLOSE);
     }
 
     uint countOpenLight()
     {
-        uint count = 0;
-        iterateRange({0, 0}, {LIGHT_NUM - 1, LIGHT_NUM - 1}, [&count, this](uint x, uint y) {
-            if (isOpen({x, y}))
-            {
-                count++;
-            }
+        return countOpenLightInRange({0, 0}, {LIGHT_NUM - 1, LIGHT_NUM - 1});
+    }
+
+    uint countOpenLightInRange(const Range &range) const
+    {
+        return countOpenLightInRange(range.start, range.end);
+    }
+    uint countOpenLightInRange(const Position &start, const Position &end) const
+    {
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::COUNT_RANGE, getRangeSize(start, end)));
+
+        return openLightIndex_.sum(start.x, start.y, end.x, end.y, [this](uint x, uint startY, uint endY) {
+            return std::count(lightMatrix_[x].begin() + startY, lightMatrix_[x].begin() + endY, LightState::OPEN);
         });
+    }
+
+    // an open light has brightness 1 in this model
+    uint sumBrightnessInRange(const Range &range) const
+    {
+        return countOpenLightInRange(range);
+    }
+    uint sumBrightnessInRange(const Position &start, const Position &end) const
+    {
+        return countOpenLightInRange(start, end);
+    }
+
+    void restoreLightStateWithRange(const Range &range, const RangeState &states)
+    {
+        validateInput(range.start);
+        validateInput(range.end);
+        if (states.size() != getRangeSize(range.start, range.end))
+        {
+            throw std::invalid_argument("range state size is invalid");
+        }
 
-        return count;
+        auto state = states.begin();
+        iterateRange(range.start, range.end, [&state, this](uint x, uint y) {
+            writeLightState(x, y, *state++);
+        });
+        openLightIndex_.commit(range.start.x, range.start.y, range.end.x, range.end.y);
+    }
+
+    void apply(const Instruction &instruction)
+    {
+        const auto &range = instruction.range;
+        switch (instruction.operation)
+        {
+        case Operation::SET:
+            setLightStateWithRange(range, instruction.state);
+            break;
+        case Operation::OPEN:
+            openLightWithRange(range.start, range.end);
+            break;
+        case Operation::CLOSE:
+            closeLightWithRange(range.start, range.end);
+            break;
+        case Operation::SWITCH:
+            switchLightWithRange(range.start, range.end);
+            break;
+        }
+    }
+
+    // switching is its own inverse, the other operations remember the cells they change
+    UndoRecord applyWithUndo(const Instruction &instruction)
+    {
+        const auto &range = instruction.range;
+        validateInput(range.start);
+        validateInput(range.end);
+
+        UndoRecord undo;
+        if (instruction.operation != Operation::SWITCH)
+        {
+            auto target = getTargetState(instruction);
+            iterateRange(range.start, range.end, [target, &undo, this](uint x, uint y) {
+                if (lightMatrix_[x][y] != target)
+                {
+                    undo.preImage.emplace_back(x * LIGHT_NUM + y, lightMatrix_[x][y]);
+                }
+            });
+        }
+
+        apply(instruction);
+        return undo;
+    }
+
+    void undo(const Instruction &instruction, const UndoRecord &undo)
+    {
+        const auto &range = instruction.range;
+        if (instruction.operation == Operation::SWITCH)
+        {
+            switchLightWithRange(range.start, range.end);
+            return;
+        }
+
+        validateInput(range.start);
+        validateInput(range.end);
+        for (const auto &[cell, state] : undo.preImage)
+        {
+            writeLightState(cell / LIGHT_NUM, cell % LIGHT_NUM, state);
+        }
+        openLightIndex_.commit(range.start.x, range.start.y, range.end.x, range.end.y);
+    }
+
+    // applies the instructions window by window with temporal blocking, see applyTemporalBlocked;
+    // the result is the same as applying them one by one, but every range is validated up front
+    void applyBatch(const std::vector<Instruction> &instructions, size_t window = 64)
+    {
+        size_t cells = 0;
+        for (const auto &instruction : instructions)
+        {
+            validateInput(instruction.range.start);
+            validateInput(instruction.range.end);
+            cells += getRangeSize(instruction.range.start, instruction.range.end);
+        }
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::APPLY_BATCH, cells));
+
+        applyTemporalBlocked<LIGHT_NUM>(
+            instructions, window,
+            [this](const Instruction &instruction, uint x, uint startY, uint endY) {
+                if (instruction.operation == Operation::SWITCH)
+                {
+                    for (auto y = startY; y <= endY; y++)
+                    {
+                        writeLightState(x, y, lightMatrix_[x][y] == LightState::CLOSE ? LightState::OPEN : LightState::CLOSE);
+                    }
+                    return;
+                }
+
+                auto target = getTargetState(instruction);
+                for (auto y = startY; y <= endY; y++)
+                {
+                    writeLightState(x, y, target);
+                }
+            },
+            [this](uint startX, uint startY, uint endX, uint endY) {
+                openLightIndex_.commit(startX, startY, endX, endY);
+            });
+    }
+
+    const LightGrid &getLightGrid() const
+    {
+        return lightMatrix_;
     }
 
     template <typename Lambda>
@@ -151,9 +328,43 @@ public:
     }
 
 private:
+    static LightState getTargetState(const Instruction &instruction)
+    {
+        switch (instruction.operation)
+        {
+        case Operation::OPEN:
+            return LightState::OPEN;
+        case Operation::CLOSE:
+            return LightState::CLOSE;
+        default:
+            return instruction.state;
+        }
+    }
+
+    void writeLightState(uint x, uint y, LightState state)
+    {
+        if (lightMatrix_[x][y] != state)
+        {
+            openLightIndex_.add(x, y, state == LightState::OPEN ? 1 : -1);
+            lightMatrix_[x][y] = state;
+        }
+    }
+
+    void writeLightStateWithRange(const Position &start, const Position &end, LightState state)
+    {
+        iterateRange(start, end, [state, this](uint x, uint y) {
+            writeLightState(x, y, state);
+        });
+        openLightIndex_.commit(start.x, start.y, end.x, end.y);
+    }
+
     size_t getRangeSize(const Position &start, const Position &end) const noexcept
     {
-        return (end.x - start.x + 1) * (end.y - start.y + 1);
+        if (start.x > end.x || start.y > end.y)
+        {
+            return 0;
+        }
+        return static_cast<size_t>(end.x - start.x + 1) * (end.y - start.y + 1);
     }
 
     bool checkOutOfRange(uint x, uint y) const
@@ -165,6 +376,7 @@ private:
     {
         if (checkOutOfRange(x, y))
         {
+            LIGHT_STATS(LightOpStats::recordValidationFailure());
             throw std::out_of_range("light position is invalid");
         }
     }
@@ -176,4 +388,5 @@ private:
 
 private:
     LightGrid lightMatrix_;
+    TileSumIndex<LIGHT_NUM> openLightIndex_;
 };
\ No newline at end of file
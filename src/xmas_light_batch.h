@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <sys/types.h>
+
+// Temporal blocking for long instruction sequences. The instructions are taken window by window;
+// within a window the grid is walked tile by tile and every instruction of the window that
+// intersects the tile is applied to it in order. Each cell still sees the instructions in their
+// original order, but a tile is loaded into cache once per window instead of once per instruction.
+//
+// applyRow(instruction, x, startY, endY) must apply the instruction to the cells [startY, endY]
+// of row x; commitRange(startX, startY, endX, endY) is called once per window with the bounding
+// box of the window's ranges.
+template <uint GRID_SIZE, uint TILE_SIZE = 128, typename Instruction, typename ApplyRow, typename CommitRange>
+void applyTemporalBlocked(const std::vector<Instruction> &instructions, size_t window, ApplyRow applyRow,
+                          CommitRange commitRange)
+{
+    window = std::max<size_t>(window, 1);
+    for (size_t first = 0; first < instructions.size(); first += window)
+    {
+        auto last = std::min(first + window, instructions.size());
+
+        uint boundStartX = GRID_SIZE, boundStartY = GRID_SIZE, boundEndX = 0, boundEndY = 0;
+        for (auto index = first; index < last; index++)
+        {
+            const auto &range = instructions[index].range;
+            if (range.start.x <= range.end.x && range.start.y <= range.end.y)
+            {
+                boundStartX = std::min(boundStartX, range.start.x);
+                boundStartY = std::min(boundStartY, range.start.y);
+                boundEndX = std::max(boundEndX, range.end.x);
+                boundEndY = std::max(boundEndY, range.end.y);
+            }
+        }
+        if (boundStartX > boundEndX || boundStartY > boundEndY)
+        {
+            continue;
+        }
+
+        for (auto tileX = boundStartX / TILE_SIZE * TILE_SIZE; tileX <= boundEndX; tileX += TILE_SIZE)
+        {
+            for (auto tileY = boundStartY / TILE_SIZE * TILE_SIZE; tileY <= boundEndY; tileY += TILE_SIZE)
+            {
+                for (auto index = first; index < last; index++)
+                {
+                    const auto &range = instructions[index].range;
+                    auto startX = std::max(range.start.x, tileX);
+                    auto endX = std::min(range.end.x, tileX + TILE_SIZE - 1);
+                    auto startY = std::max(range.start.y, tileY);
+                    auto endY = std::min(range.end.y, tileY + TILE_SIZE - 1);
+                    if (startY > endY)
+                    {
+                        continue;
+                    }
+                    for (auto x = startX; x <= endX; x++)
+                    {
+                        applyRow(instructions[index], x, startY, endY);
+                    }
+                }
+            }
+        }
+        commitRange(boundStartX, boundStartY, boundEndX, boundEndY);
+    }
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Writes LightManager grids to a file descriptor as images or as a raw frame stream.
+//
+// Raw frames start with a FrameHeader. A keyframe carries every row straight from the grid
+// storage; a delta frame carries only the rows changed since the previous frame, each one
+// prefixed with its uint32_t row index.
+template <typename Manager>
+class LightFrameExporter
+{
+public:
+    using LightGrid = typename Manager::LightGrid;
+
+    static constexpr uint GRID_SIZE = Manager::GRID_SIZE;
+    static constexpr uint32_t FLAG_KEYFRAME = 1;
+
+    struct FrameHeader
+    {
+        char magic[4];
+        uint32_t gridSize;
+        uint32_t cellBytes;
+        uint32_t flags;
+        uint32_t rowCount;
+        uint32_t reserved;
+        uint64_t frameNumber;
+    };
+
+    explicit LightFrameExporter(int fd) : fd_(fd) {}
+
+    // P4 bitmap, an open light is a set bit
+    void writePbm(const Manager &manager)
+    {
+        const auto &grid = manager.getLightGrid();
+        auto header = "P4\n" + std::to_string(GRID_SIZE) + ' ' + std::to_string(GRID_SIZE) + '\n';
+        constexpr size_t rowBytes = (GRID_SIZE + 7) / 8;
+
+        buffer_.assign(rowBytes * GRID_SIZE, 0);
+        for (uint x = 0; x < GRID_SIZE; x++)
+        {
+            auto *row = &buffer_[x * rowBytes];
+            for (uint y = 0; y < GRID_SIZE; y++)
+            {
+                if (static_cast<uint>(grid[x][y]) != 0)
+                {
+                    row[y / 8] |= 0x80 >> (y % 8);
+                }
+            }
+        }
+        writeImage(header);
+    }
+
+    // 16 bit P5 graymap, MAX_LIGHT_LEVEL maps to white
+    void writePgm(const Manager &manager)
+    {
+        const auto &grid = manager.getLightGrid();
+        auto header = "P5\n" + std::to_string(GRID_SIZE) + ' ' + std::to_string(GRID_SIZE) + "\n65535\n";
+
+        buffer_.resize(size_t{2} * GRID_SIZE * GRID_SIZE);
+        auto *sample = buffer_.data();
+        for (uint x = 0; x < GRID_SIZE; x++)
+        {
+            for (uint y = 0; y < GRID_SIZE; y++)
+            {
+                auto level = std::min(static_cast<uint>(grid[x][y]), Manager::MAX_LIGHT_LEVEL);
+                auto value = static_cast<uint32_t>(uint64_t{level} * 65535 / Manager::MAX_LIGHT_LEVEL);
+                *sample++ = static_cast<unsigned char>(value >> 8);
+                *sample++ = static_cast<unsigned char>(value & 0xFF);
+            }
+        }
+        writeImage(header);
+    }
+
+    void writeKeyframe(const Manager &manager)
+    {
+        const auto &grid = manager.getLightGrid();
+        auto header = makeHeader(FLAG_KEYFRAME, GRID_SIZE);
+
+        iovec parts[] = {{&header, sizeof(header)}, {const_cast<LightGrid *>(&grid), sizeof(grid)}};
+        writeAll(parts, 2);
+
+        if (!previous_)
+        {
+            previous_ = std::make_unique<LightGrid>();
+        }
+        *previous_ = grid;
+    }
+
+    // falls back to a keyframe when there is no previous frame to diff against
+    void writeDeltaFrame(const Manager &manager)
+    {
+        if (!previous_)
+        {
+            writeKeyframe(manager);
+            return;
+        }
+
+        const auto &grid = manager.getLightGrid();
+        changedRows_.clear();
+        for (uint32_t x = 0; x < GRID_SIZE; x++)
+        {
+            if (std::memcmp(&grid[x], &(*previous_)[x], sizeof(grid[x])) != 0)
+            {
+                changedRows_.push_back(x);
+            }
+        }
+
+        auto header = makeHeader(0, static_cast<uint32_t>(changedRows_.size()));
+        std::vector<iovec> parts;
+        parts.reserve(1 + 2 * changedRows_.size());
+        parts.push_back({&header, sizeof(header)});
+        for (auto &x : changedRows_)
+        {
+            parts.push_back({&x, sizeof(x)});
+            parts.push_back({const_cast<void *>(static_cast<const void *>(&grid[x])), sizeof(grid[x])});
+        }
+        writeAll(parts.data(), parts.size());
+
+        for (auto x : changedRows_)
+        {
+            (*previous_)[x] = grid[x];
+        }
+    }
+
+    uint64_t getFrameNumber() const
+    {
+        return frameNumber_;
+    }
+
+private:
+    FrameHeader makeHeader(uint32_t flags, uint32_t rowCount)
+    {
+        FrameHeader header{};
+        std::memcpy(header.magic, "XLF1", sizeof(header.magic));
+        header.gridSize = GRID_SIZE;
+        header.cellBytes = sizeof(typename LightGrid::value_type::value_type);
+        header.flags = flags;
+        header.rowCount = rowCount;
+        header.frameNumber = frameNumber_++;
+        return header;
+    }
+
+    void writeImage(std::string &header)
+    {
+        iovec parts[] = {{&header[0], header.size()}, {buffer_.data(), buffer_.size()}};
+        writeAll(parts, 2);
+    }
+
+    void writeAll(iovec *parts, size_t count)
+    {
+        while (count > 0)
+        {
+            auto written = ::writev(fd_, parts, static_cast<int>(std::min<size_t>(count, IOV_MAX)));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "light frame write failed");
+            }
+
+            auto remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= parts->iov_len)
+            {
+                remaining -= parts->iov_len;
+                parts++;
+                count--;
+            }
+            if (count > 0)
+            {
+                parts->iov_base = static_cast<char *>(parts->iov_base) + remaining;
+                parts->iov_len -= remaining;
+            }
+        }
+    }
+
+    int fd_;
+    uint64_t frameNumber_{0};
+    std::vector<unsigned char> buffer_;
+    std::vector<uint32_t> changedRows_;
+    std::unique_ptr<LightGrid> previous_;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <sys/types.h>
+
+// Rectangle sums over a square grid. The grid is split into TILE_SIZE x TILE_SIZE tiles whose
+// sums live in a 2D Fenwick tree, so a query costs a Fenwick lookup for the fully covered tiles
+// plus a scan of the partially covered border cells.
+template <uint GRID_SIZE, uint TILE_SIZE = 16>
+class TileSumIndex
+{
+public:
+    static constexpr uint TILE_NUM = (GRID_SIZE + TILE_SIZE - 1) / TILE_SIZE;
+
+    // cheap per cell bookkeeping, the change becomes visible to queries after commit()
+    void add(uint x, uint y, long long delta)
+    {
+        tileSums_[x / TILE_SIZE][y / TILE_SIZE] += delta;
+    }
+
+    void commit(uint startX, uint startY, uint endX, uint endY)
+    {
+        for (auto tileX = startX / TILE_SIZE; tileX <= endX / TILE_SIZE; tileX++)
+        {
+            for (auto tileY = startY / TILE_SIZE; tileY <= endY / TILE_SIZE; tileY++)
+            {
+                auto delta = tileSums_[tileX][tileY] - committedSums_[tileX][tileY];
+                if (delta != 0)
+                {
+                    updateFenwick(tileX, tileY, delta);
+                    committedSums_[tileX][tileY] = tileSums_[tileX][tileY];
+                }
+            }
+        }
+    }
+
+    // rowSum(x, startY, endY) must return the sum of the cells [startY, endY) of row x
+    template <typename RowSum>
+    long long sum(uint startX, uint startY, uint endX, uint endY, RowSum rowSum) const
+    {
+        if (startX > endX || startY > endY)
+        {
+            return 0;
+        }
+
+        auto fullStartX = (startX + TILE_SIZE - 1) / TILE_SIZE;
+        auto fullEndX = (endX + 1) / TILE_SIZE;
+        auto fullStartY = (startY + TILE_SIZE - 1) / TILE_SIZE;
+        auto fullEndY = (endY + 1) / TILE_SIZE;
+        if (fullStartX >= fullEndX || fullStartY >= fullEndY)
+        {
+            long long total = 0;
+            for (auto x = startX; x <= endX; x++)
+            {
+                total += rowSum(x, startY, endY + 1);
+            }
+            return total;
+        }
+
+        long long total = prefixSum(fullEndX, fullEndY) - prefixSum(fullStartX, fullEndY) -
+                          prefixSum(fullEndX, fullStartY) + prefixSum(fullStartX, fullStartY);
+
+        for (auto x = startX; x <= endX; x++)
+        {
+            if (x < fullStartX * TILE_SIZE || x >= fullEndX * TILE_SIZE)
+            {
+                total += rowSum(x, startY, endY + 1);
+            }
+            else
+            {
+                total += rowSum(x, startY, fullStartY * TILE_SIZE);
+                total += rowSum(x, fullEndY * TILE_SIZE, endY + 1);
+            }
+        }
+        return total;
+    }
+
+private:
+    void updateFenwick(uint tileX, uint tileY, long long delta)
+    {
+        for (auto i = tileX + 1; i <= TILE_NUM; i += i & -i)
+        {
+            for (auto j = tileY + 1; j <= TILE_NUM; j += j & -j)
+            {
+                fenwick_[i - 1][j - 1] += delta;
+            }
+        }
+    }
+
+    // sum of the tiles [0, tileX) x [0, tileY)
+    long long prefixSum(uint tileX, uint tileY) const
+    {
+        long long total = 0;
+        for (auto i = tileX; i > 0; i -= i & -i)
+        {
+            for (auto j = tileY; j > 0; j -= j & -j)
+            {
+                total += fenwick_[i - 1][j - 1];
+            }
+        }
+        return total;
+    }
+
+    using TileArray = std::array<std::array<long long, TILE_NUM>, TILE_NUM>;
+
+    TileArray tileSums_{};
+    TileArray committedSums_{};
+    TileArray fenwick_{};
+};
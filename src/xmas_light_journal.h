@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Journaled mode for a LightManager. Every instruction is recorded together with what is needed
+// to undo it, and a dense keyframe of the grid is taken every keyframeInterval instructions, so
+// the state at any instruction index is one keyframe load plus a bounded replay.
+template <typename Manager>
+class LightJournal
+{
+public:
+    using Instruction = typename Manager::Instruction;
+    using Range = typename Manager::Range;
+
+    explicit LightJournal(Manager &manager, size_t keyframeInterval = 1000)
+        : manager_(manager), keyframeInterval_(keyframeInterval == 0 ? 1 : keyframeInterval)
+    {
+        takeKeyframe();
+    }
+
+    void apply(const Instruction &instruction)
+    {
+        auto undo = manager_.applyWithUndo(instruction);
+        entries_.push_back({instruction, std::move(undo)});
+        if (entries_.size() % keyframeInterval_ == 0)
+        {
+            takeKeyframe();
+        }
+    }
+
+    // number of journaled instructions
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    const Instruction &getInstruction(size_t index) const
+    {
+        return entries_.at(index).instruction;
+    }
+
+    void undo(size_t count = 1)
+    {
+        if (count > entries_.size())
+        {
+            throw std::out_of_range("undo count is invalid");
+        }
+
+        for (; count > 0; count--)
+        {
+            const auto &entry = entries_.back();
+            manager_.undo(entry.instruction, entry.undo);
+            entries_.pop_back();
+        }
+        while (keyframes_.back().index > entries_.size())
+        {
+            keyframes_.pop_back();
+        }
+    }
+
+    // the grid as it was after the first index instructions
+    std::unique_ptr<Manager> getStateAt(size_t index) const
+    {
+        if (index > entries_.size())
+        {
+            throw std::out_of_range("instruction index is invalid");
+        }
+
+        auto keyframe = keyframes_.rbegin();
+        while (keyframe->index > index)
+        {
+            keyframe++;
+        }
+
+        auto state = std::make_unique<Manager>();
+        state->restoreLightStateWithRange(getFullRange(), keyframe->states);
+        for (auto replay = keyframe->index; replay < index; replay++)
+        {
+            state->apply(entries_[replay].instruction);
+        }
+        return state;
+    }
+
+private:
+    struct Entry
+    {
+        Instruction instruction;
+        typename Manager::UndoRecord undo;
+    };
+
+    struct Keyframe
+    {
+        size_t index;
+        typename Manager::RangeState states;
+    };
+
+    static Range getFullRange()
+    {
+        return {{0, 0}, {Manager::GRID_SIZE - 1, Manager::GRID_SIZE - 1}};
+    }
+
+    void takeKeyframe()
+    {
+        keyframes_.push_back({entries_.size(), manager_.getLightStateWithRange(getFullRange())});
+    }
+
+    Manager &manager_;
+    size_t keyframeInterval_;
+    std::vector<Entry> entries_;
+    std::vector<Keyframe> keyframes_;
+};
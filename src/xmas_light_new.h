@@ -1,5 +1,14 @@
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "xmas_light_batch.h"
+#include "xmas_light_index.h"
+#include "xmas_light_stats.h"
 
 constexpr uint LIGHT_NUM = 1000;
 
@@ -32,9 +41,85 @@ const int LightBrightness::OPEN_DELTA = 1;
 const int LightBrightness::CLOSE_DELTA = -1;
 const int LightBrightness::SWITCH_DELTA = 2;
 
+// Number of lights at each brightness level; values above MAX_BRIGHTNESS share the last bin.
+class BrightnessHistogram
+{
+public:
+    static constexpr uint BIN_NUM = MAX_BRIGHTNESS + 1;
+
+    uint64_t getCount(Brightness level) const
+    {
+        return bins_[getBin(level)];
+    }
+
+    uint64_t getTotal() const
+    {
+        return total_;
+    }
+
+    void add(Brightness level, uint64_t count = 1)
+    {
+        bins_[getBin(level)] += count;
+        total_ += count;
+    }
+
+    void move(Brightness from, Brightness to)
+    {
+        bins_[getBin(from)]--;
+        bins_[getBin(to)]++;
+    }
+
+    void merge(const BrightnessHistogram &other)
+    {
+        for (uint bin = 0; bin < BIN_NUM; bin++)
+        {
+            bins_[bin] += other.bins_[bin];
+        }
+        total_ += other.total_;
+    }
+
+    // smallest level such that at least ratio of all lights are at or below it
+    Brightness getQuantile(double ratio) const
+    {
+        if (ratio < 0.0 || ratio > 1.0)
+        {
+            throw std::out_of_range("quantile ratio is invalid");
+        }
+
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(ratio * total_)));
+        uint64_t cumulative = 0;
+        for (uint bin = 0; bin < BIN_NUM; bin++)
+        {
+            cumulative += bins_[bin];
+            if (cumulative >= rank)
+            {
+                return bin;
+            }
+        }
+        return 0;
+    }
+
+    Brightness getMedian() const
+    {
+        return getQuantile(0.5);
+    }
+
+private:
+    static uint getBin(Brightness level)
+    {
+        return std::min(level, MAX_BRIGHTNESS);
+    }
+
+    std::array<uint64_t, BIN_NUM> bins_{};
+    uint64_t total_ = 0;
+};
+
 class LightManager
 {
 public:
+    static constexpr uint GRID_SIZE = LIGHT_NUM;
+    static constexpr uint MAX_LIGHT_LEVEL = MAX_BRIGHTNESS;
+
     struct Position
     {
         uint x;
@@ -50,7 +135,31 @@ public:
     using LightGrid = std::array<std::array<LightBrightness, LIGHT_NUM>, LIGHT_NUM>;
     using RangeState = std::vector<LightBrightness>;
 
-    LightManager() : lightMatrix_() {}
+    enum class Operation
+    {
+        SET = 0,
+        OPEN,
+        CLOSE,
+        SWITCH
+    };
+
+    struct Instruction
+    {
+        Operation operation;
+        Range range;
+        LightBrightness state{LightBrightness::CLOSE};
+    };
+
+    // cells (x * LIGHT_NUM + y) that undoing an instruction has to write back
+    struct UndoRecord
+    {
+        std::vector<std::pair<uint, LightBrightness>> preImage;
+    };
+
+    LightManager() : lightMatrix_()
+    {
+        brightnessHistogram_.add(LightBrightness::CLOSE, static_cast<uint64_t>(LIGHT_NUM) * LIGHT_NUM);
+    }
 
     LightBrightness getLightState(uint x, uint y) const
     {
@@ -61,7 +170,8 @@ public:
     void setLightState(uint x, uint y, LightBrightness state)
     {
         validateInput(x, y);
-        lightMatrix_[x][y] = state;
+        writeLightState(x, y, state);
+        commitIndex({x, y}, {x, y});
     }
 
     void modifyLightState(uint x, uint y, int delta)
@@ -96,6 +206,7 @@ public:
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::GET_RANGE, getRangeSize(start, end)));
 
         RangeState states;
         states.reserve(getRangeSize(start, end));
@@ -115,62 +226,230 @@ public:
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::SET_RANGE, getRangeSize(start, end)));
 
         iterateRange(start, end, [state, this](uint x, uint y) {
-            setLightState(x, y, state);
+            writeLightState(x, y, state);
         });
+        commitIndex(start, end);
+    }
+
+    void modifyLightStateWithRange(const Position &start, const Position &end, int delta)
+    {
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::MODIFY_RANGE, getRangeSize(start, end)));
+
+        writeDeltaWithRange(start, end, delta);
     }
 
     void switchLightWithRange(const Position &start, const Position &end)
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::SWITCH_RANGE, getRangeSize(start, end)));
 
-        iterateRange(start, end, [this](uint x, uint y) {
-            switchLight(x, y);
-        });
+        writeDeltaWithRange(start, end, LightBrightness::SWITCH_DELTA);
     }
 
     void openLightWithRange(const Position &start, const Position &end)
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::OPEN_RANGE, getRangeSize(start, end)));
 
-        iterateRange(start, end, [this](uint x, uint y) {
-            openLight(x, y);
-        });
+        writeDeltaWithRange(start, end, LightBrightness::OPEN_DELTA);
     }
 
     void closeLightWithRange(const Position &start, const Position &end)
     {
         validateInput(start);
         validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::CLOSE_RANGE, getRangeSize(start, end)));
 
-        iterateRange(start, end, [this](uint x, uint y) {
-            closeLight(x, y);
-        });
+        writeDeltaWithRange(start, end, LightBrightness::CLOSE_DELTA);
     }
 
     uint countOpenLight()
     {
-        uint count = 0;
-        iterateRange({0, 0}, {LIGHT_NUM - 1, LIGHT_NUM - 1}, [&count, this](uint x, uint y) {
-            if (isOpen({x, y}))
+        return countOpenLightInRange({0, 0}, {LIGHT_NUM - 1, LIGHT_NUM - 1});
+    }
+
+    uint countBrightness(){
+        return sumBrightnessInRange({0, 0}, {LIGHT_NUM - 1, LIGHT_NUM - 1});
+    }
+
+    uint countOpenLightInRange(const Range &range) const
+    {
+        return countOpenLightInRange(range.start, range.end);
+    }
+    uint countOpenLightInRange(const Position &start, const Position &end) const
+    {
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::COUNT_RANGE, getRangeSize(start, end)));
+
+        return openLightIndex_.sum(start.x, start.y, end.x, end.y, [this](uint x, uint startY, uint endY) {
+            return std::count_if(lightMatrix_[x].begin() + startY, lightMatrix_[x].begin() + endY,
+                                 [](LightBrightness light) { return light.value >= LightBrightness::OPEN; });
+        });
+    }
+
+    uint sumBrightnessInRange(const Range &range) const
+    {
+        return sumBrightnessInRange(range.start, range.end);
+    }
+    uint sumBrightnessInRange(const Position &start, const Position &end) const
+    {
+        validateInput(start);
+        validateInput(end);
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::SUM_RANGE, getRangeSize(start, end)));
+
+        return brightnessIndex_.sum(start.x, start.y, end.x, end.y, [this](uint x, uint startY, uint endY) {
+            long long sum = 0;
+            for (auto y = startY; y < endY; y++)
             {
-                count++;
+                sum += lightMatrix_[x][y].value;
             }
+            return sum;
         });
+    }
 
-        return count;
+    const BrightnessHistogram &getBrightnessHistogram() const
+    {
+        return brightnessHistogram_;
     }
 
-    uint countBrightness(){
-        uint count = 0;
-        iterateRange({0,0}, {LIGHT_NUM-1, LIGHT_NUM-1},[&count,this](uint x, uint y){
-            count += getLightState(x,y);
-       });
+    void restoreLightStateWithRange(const Range &range, const RangeState &states)
+    {
+        validateInput(range.start);
+        validateInput(range.end);
+        if (states.size() != getRangeSize(range.start, range.end))
+        {
+            throw std::invalid_argument("range state size is invalid");
+        }
 
-       return count;
+        auto state = states.begin();
+        iterateRange(range.start, range.end, [&state, this](uint x, uint y) {
+            writeLightState(x, y, *state++);
+        });
+        commitIndex(range.start, range.end);
+    }
+
+    void apply(const Instruction &instruction)
+    {
+        const auto &range = instruction.range;
+        switch (instruction.operation)
+        {
+        case Operation::SET:
+            setLightStateWithRange(range, instruction.state);
+            break;
+        case Operation::OPEN:
+            openLightWithRange(range.start, range.end);
+            break;
+        case Operation::CLOSE:
+            closeLightWithRange(range.start, range.end);
+            break;
+        case Operation::SWITCH:
+            switchLightWithRange(range.start, range.end);
+            break;
+        }
+    }
+
+    // brightness changes are undone by the opposite delta, only cells where the
+    // brightness got clamped (or a set overwrote them) keep their old value
+    UndoRecord applyWithUndo(const Instruction &instruction)
+    {
+        const auto &range = instruction.range;
+        validateInput(range.start);
+        validateInput(range.end);
+
+        UndoRecord undo;
+        if (instruction.operation == Operation::SET)
+        {
+            auto target = instruction.state;
+            iterateRange(range.start, range.end, [target, &undo, this](uint x, uint y) {
+                if (lightMatrix_[x][y].value != target.value)
+                {
+                    undo.preImage.emplace_back(x * LIGHT_NUM + y, lightMatrix_[x][y]);
+                }
+            });
+        }
+        else
+        {
+            auto delta = getDelta(instruction.operation);
+            iterateRange(range.start, range.end, [delta, &undo, this](uint x, uint y) {
+                auto oldState = lightMatrix_[x][y];
+                if (static_cast<int>(calcValidBrightness(oldState, delta)) != static_cast<int>(oldState) + delta)
+                {
+                    undo.preImage.emplace_back(x * LIGHT_NUM + y, oldState);
+                }
+            });
+        }
+
+        apply(instruction);
+        return undo;
+    }
+
+    void undo(const Instruction &instruction, const UndoRecord &undo)
+    {
+        const auto &range = instruction.range;
+        validateInput(range.start);
+        validateInput(range.end);
+
+        if (instruction.operation != Operation::SET)
+        {
+            auto delta = getDelta(instruction.operation);
+            iterateRange(range.start, range.end, [delta, this](uint x, uint y) {
+                writeLightState(x, y, static_cast<uint>(static_cast<int>(lightMatrix_[x][y]) - delta));
+            });
+        }
+        for (const auto &[cell, state] : undo.preImage)
+        {
+            writeLightState(cell / LIGHT_NUM, cell % LIGHT_NUM, state);
+        }
+        commitIndex(range.start, range.end);
+    }
+
+    // applies the instructions window by window with temporal blocking, see applyTemporalBlocked;
+    // the result is the same as applying them one by one, but every range is validated up front
+    void applyBatch(const std::vector<Instruction> &instructions, size_t window = 64)
+    {
+        size_t cells = 0;
+        for (const auto &instruction : instructions)
+        {
+            validateInput(instruction.range.start);
+            validateInput(instruction.range.end);
+            cells += getRangeSize(instruction.range.start, instruction.range.end);
+        }
+        LIGHT_STATS(LightOpStats::ScopedTimer timer(LightOperation::APPLY_BATCH, cells));
+
+        applyTemporalBlocked<LIGHT_NUM>(
+            instructions, window,
+            [this](const Instruction &instruction, uint x, uint startY, uint endY) {
+                if (instruction.operation == Operation::SET)
+                {
+                    for (auto y = startY; y <= endY; y++)
+                    {
+                        writeLightState(x, y, instruction.state);
+                    }
+                    return;
+                }
+
+                auto delta = getDelta(instruction.operation);
+                for (auto y = startY; y <= endY; y++)
+                {
+                    writeLightState(x, y, calcValidBrightness(lightMatrix_[x][y], delta));
+                }
+            },
+            [this](uint startX, uint startY, uint endX, uint endY) {
+                commitIndex({startX, startY}, {endX, endY});
+            });
+    }
+
+    const LightGrid &getLightGrid() const
+    {
+        return lightMatrix_;
     }
 
     template <typename Lambda>
@@ -191,6 +470,47 @@ public:
     }
 
 private:
+    static int getDelta(Operation operation)
+    {
+        switch (operation)
+        {
+        case Operation::OPEN:
+            return LightBrightness::OPEN_DELTA;
+        case Operation::CLOSE:
+            return LightBrightness::CLOSE_DELTA;
+        case Operation::SWITCH:
+            return LightBrightness::SWITCH_DELTA;
+        default:
+            return 0;
+        }
+    }
+
+    void writeLightState(uint x, uint y, LightBrightness state)
+    {
+        auto oldState = lightMatrix_[x][y];
+        if (oldState.value != state.value)
+        {
+            openLightIndex_.add(x, y, (state >= LightBrightness::OPEN) - (oldState >= LightBrightness::OPEN));
+            brightnessIndex_.add(x, y, static_cast<long long>(state.value) - oldState.value);
+            brightnessHistogram_.move(oldState, state);
+            lightMatrix_[x][y] = state;
+        }
+    }
+
+    void writeDeltaWithRange(const Position &start, const Position &end, int delta)
+    {
+        iterateRange(start, end, [delta, this](uint x, uint y) {
+            writeLightState(x, y, calcValidBrightness(lightMatrix_[x][y], delta));
+        });
+        commitIndex(start, end);
+    }
+
+    void commitIndex(const Position &start, const Position &end)
+    {
+        openLightIndex_.commit(start.x, start.y, end.x, end.y);
+        brightnessIndex_.commit(start.x, start.y, end.x, end.y);
+    }
+
     LightBrightness calcValidBrightness(LightBrightness oldBrightness, int delta) const
     {
         auto newBrightness = static_cast<int>(oldBrightness) + delta;
@@ -208,7 +528,11 @@ private:
 
     size_t getRangeSize(const Position &start, const Position &end) const noexcept
     {
-        return (end.x - start.x + 1) * (end.y - start.y + 1);
+        if (start.x > end.x || start.y > end.y)
+        {
+            return 0;
+        }
+        return static_cast<size_t>(end.x - start.x + 1) * (end.y - start.y + 1);
     }
 
     bool checkOutOfRange(uint x, uint y) const
@@ -220,6 +544,7 @@ private:
     {
         if (checkOutOfRange(x, y))
         {
+            LIGHT_STATS(LightOpStats::recordValidationFailure());
             throw std::out_of_range("light position is invalid");
         }
     }
@@ -231,4 +556,7 @@ private:
 
 private:
     LightGrid lightMatrix_;
+    TileSumIndex<LIGHT_NUM> openLightIndex_;
+    TileSumIndex<LIGHT_NUM> brightnessIndex_;
+    BrightnessHistogram brightnessHistogram_;
 };
\ No newline at end of file
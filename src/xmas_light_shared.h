@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A light grid living in a named POSIX shared memory segment so several processes can read and
+// mutate it. The segment holds a versioned header, an on/off bit plane and a brightness plane.
+// Every cell update is a single atomic word operation, so concurrent range operations from
+// different processes never lose updates; a range operation as a whole is not atomic.
+class SharedLightGrid
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t MAX_BRIGHTNESS = 1000;
+
+    enum class OpenMode
+    {
+        CREATE,
+        ATTACH
+    };
+
+    struct Position
+    {
+        uint x;
+        uint y;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t gridSize;
+        uint64_t wordsPerRow;
+        std::atomic<uint32_t> ready;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "bit plane words must be lock free");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "brightness cells must be lock free");
+
+    SharedLightGrid(const std::string &name, OpenMode mode, uint gridSize = 1000) : name_(name)
+    {
+        int flags = mode == OpenMode::CREATE ? O_RDWR | O_CREAT | O_EXCL : O_RDWR;
+        fd_ = ::shm_open(name.c_str(), flags | O_CLOEXEC, 0600);
+        if (fd_ < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        }
+
+        try
+        {
+            if (mode == OpenMode::CREATE)
+            {
+                create(gridSize);
+            }
+            else
+            {
+                attach();
+            }
+        }
+        catch (...)
+        {
+            release();
+            if (mode == OpenMode::CREATE)
+            {
+                ::shm_unlink(name.c_str());
+            }
+            throw;
+        }
+    }
+
+    SharedLightGrid(const SharedLightGrid &) = delete;
+    SharedLightGrid &operator=(const SharedLightGrid &) = delete;
+
+    ~SharedLightGrid()
+    {
+        release();
+    }
+
+    static void unlink(const std::string &name)
+    {
+        ::shm_unlink(name.c_str());
+    }
+
+    uint getGridSize() const
+    {
+        return gridSize_;
+    }
+
+    bool isOpen(uint x, uint y) const
+    {
+        validateInput(x, y);
+        return (getWord(x, y / 64).load(std::memory_order_relaxed) >> (y % 64)) & 1;
+    }
+
+    void openLightWithRange(const Position &start, const Position &end)
+    {
+        updateBitsWithRange(start, end, [](std::atomic<uint64_t> &word, uint64_t mask) {
+            word.fetch_or(mask, std::memory_order_relaxed);
+        });
+    }
+
+    void closeLightWithRange(const Position &start, const Position &end)
+    {
+        updateBitsWithRange(start, end, [](std::atomic<uint64_t> &word, uint64_t mask) {
+            word.fetch_and(~mask, std::memory_order_relaxed);
+        });
+    }
+
+    void switchLightWithRange(const Position &start, const Position &end)
+    {
+        updateBitsWithRange(start, end, [](std::atomic<uint64_t> &word, uint64_t mask) {
+            word.fetch_xor(mask, std::memory_order_relaxed);
+        });
+    }
+
+    uint countOpenLight() const
+    {
+        uint count = 0;
+        for (uint64_t word = 0; word < gridSize_ * wordsPerRow_; word++)
+        {
+            count += __builtin_popcountll(bits_[word].load(std::memory_order_relaxed));
+        }
+        return count;
+    }
+
+    uint getBrightness(uint x, uint y) const
+    {
+        validateInput(x, y);
+        return getCell(x, y).load(std::memory_order_relaxed);
+    }
+
+    void setBrightnessWithRange(const Position &start, const Position &end, uint brightness)
+    {
+        validateInput(start);
+        validateInput(end);
+
+        for (auto x = start.x; x <= end.x; x++)
+        {
+            for (auto y = start.y; y <= end.y; y++)
+            {
+                getCell(x, y).store(brightness, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // clamped to [0, MAX_BRIGHTNESS] with a compare and swap loop per cell
+    void modifyBrightnessWithRange(const Position &start, const Position &end, int delta)
+    {
+        validateInput(start);
+        validateInput(end);
+
+        for (auto x = start.x; x <= end.x; x++)
+        {
+            for (auto y = start.y; y <= end.y; y++)
+            {
+                auto &cell = getCell(x, y);
+                auto oldValue = cell.load(std::memory_order_relaxed);
+                while (!cell.compare_exchange_weak(oldValue, calcValidBrightness(oldValue, delta), std::memory_order_relaxed))
+                {
+                }
+            }
+        }
+    }
+
+    uint64_t countBrightness() const
+    {
+        uint64_t count = 0;
+        for (uint64_t cell = 0; cell < uint64_t{gridSize_} * gridSize_; cell++)
+        {
+            count += brightness_[cell].load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'X', 'L', 'S', 'H', 'G', 'R', 'I', 'D'};
+    static constexpr size_t HEADER_BYTES = 64;
+
+    static_assert(sizeof(Header) <= HEADER_BYTES, "header must fit in its reserved space");
+
+    static uint64_t getWordsPerRow(uint gridSize)
+    {
+        return (gridSize + 63) / 64;
+    }
+
+    static size_t getSegmentSize(uint gridSize)
+    {
+        return HEADER_BYTES + gridSize * getWordsPerRow(gridSize) * sizeof(uint64_t) +
+               uint64_t{gridSize} * gridSize * sizeof(uint32_t);
+    }
+
+    static uint32_t calcValidBrightness(uint32_t oldValue, int delta)
+    {
+        auto newValue = static_cast<int64_t>(oldValue) + delta;
+        return static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(newValue, 0), MAX_BRIGHTNESS));
+    }
+
+    void create(uint gridSize)
+    {
+        if (::ftruncate(fd_, static_cast<off_t>(getSegmentSize(gridSize))) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "ftruncate " + name_);
+        }
+        map(getSegmentSize(gridSize));
+
+        // a fresh segment is zero filled, which is a dark grid
+        auto *header = new (mapping_) Header{};
+        std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+        header->version = VERSION;
+        header->gridSize = gridSize;
+        header->wordsPerRow = getWordsPerRow(gridSize);
+        header->ready.store(1, std::memory_order_release);
+        bindPlanes(*header);
+    }
+
+    void attach()
+    {
+        struct stat segmentStat;
+        if (::fstat(fd_, &segmentStat) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "fstat " + name_);
+        }
+        if (static_cast<size_t>(segmentStat.st_size) < HEADER_BYTES)
+        {
+            throw std::runtime_error("shared light grid is not initialized: " + name_);
+        }
+        map(static_cast<size_t>(segmentStat.st_size));
+
+        auto *header = static_cast<Header *>(mapping_);
+        if (header->ready.load(std::memory_order_acquire) != 1 || std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw std::runtime_error("shared light grid is not initialized: " + name_);
+        }
+        if (header->version != VERSION || mappingSize_ != getSegmentSize(header->gridSize))
+        {
+            throw std::runtime_error("shared light grid version mismatch: " + name_);
+        }
+        bindPlanes(*header);
+    }
+
+    void map(size_t size)
+    {
+        auto *mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap " + name_);
+        }
+        mapping_ = mapping;
+        mappingSize_ = size;
+    }
+
+    void bindPlanes(const Header &header)
+    {
+        gridSize_ = header.gridSize;
+        wordsPerRow_ = header.wordsPerRow;
+        auto *base = static_cast<char *>(mapping_) + HEADER_BYTES;
+        bits_ = reinterpret_cast<std::atomic<uint64_t> *>(base);
+        brightness_ = reinterpret_cast<std::atomic<uint32_t> *>(base + gridSize_ * wordsPerRow_ * sizeof(uint64_t));
+    }
+
+    void release()
+    {
+        if (mapping_ != nullptr)
+        {
+            ::munmap(mapping_, mappingSize_);
+            mapping_ = nullptr;
+        }
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    template <typename WordUpdate>
+    void updateBitsWithRange(const Position &start, const Position &end, WordUpdate update)
+    {
+        validateInput(start);
+        validateInput(end);
+        if (start.y > end.y)
+        {
+            return;
+        }
+
+        for (auto x = start.x; x <= end.x; x++)
+        {
+            for (auto word = start.y / 64; word <= end.y / 64; word++)
+            {
+                auto firstBit = word == start.y / 64 ? start.y % 64 : 0;
+                auto lastBit = word == end.y / 64 ? end.y % 64 : 63;
+                auto mask = (~uint64_t{0} >> (63 - lastBit)) & (~uint64_t{0} << firstBit);
+                update(getWord(x, word), mask);
+            }
+        }
+    }
+
+    std::atomic<uint64_t> &getWord(uint x, uint word) const
+    {
+        return bits_[x * wordsPerRow_ + word];
+    }
+
+    std::atomic<uint32_t> &getCell(uint x, uint y) const
+    {
+        return brightness_[uint64_t{x} * gridSize_ + y];
+    }
+
+    void validateInput(uint x, uint y) const
+    {
+        if (x >= gridSize_ || y >= gridSize_)
+        {
+            throw std::out_of_range("light position is invalid");
+        }
+    }
+
+    void validateInput(const Position &p) const
+    {
+        validateInput(p.x, p.y);
+    }
+
+    std::string name_;
+    int fd_{-1};
+    void *mapping_{nullptr};
+    size_t mappingSize_{0};
+    uint gridSize_{0};
+    uint64_t wordsPerRow_{0};
+    std::atomic<uint64_t> *bits_{nullptr};
+    std::atomic<uint32_t> *brightness_{nullptr};
+};
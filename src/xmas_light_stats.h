@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// LightManager instrumentation is only compiled in with -DXMAS_LIGHT_STATS, otherwise every
+// LIGHT_STATS(...) statement disappears and snapshots stay empty.
+#ifdef XMAS_LIGHT_STATS
+#define LIGHT_STATS(statement) statement
+#else
+#define LIGHT_STATS(statement)
+#endif
+
+enum class LightOperation
+{
+    GET_RANGE = 0,
+    SET_RANGE,
+    MODIFY_RANGE,
+    OPEN_RANGE,
+    CLOSE_RANGE,
+    SWITCH_RANGE,
+    COUNT_RANGE,
+    SUM_RANGE,
+    APPLY_BATCH,
+    CUSTOM,
+    COUNT
+};
+
+// Process wide operation statistics. Every thread writes its own shard, shards are merged on read.
+class LightOpStats
+{
+public:
+    static constexpr size_t OPERATION_NUM = static_cast<size_t>(LightOperation::COUNT);
+    static constexpr size_t LATENCY_BUCKETS = 32;
+
+    struct OperationSnapshot
+    {
+        uint64_t calls{0};
+        uint64_t cells{0};
+        uint64_t totalNs{0};
+        // bucket i counts calls that took less than 2^i ns
+        std::array<uint64_t, LATENCY_BUCKETS> latency{};
+    };
+
+    struct Snapshot
+    {
+        std::array<OperationSnapshot, OPERATION_NUM> operations{};
+        uint64_t validationFailures{0};
+
+        const OperationSnapshot &operator[](LightOperation operation) const
+        {
+            return operations[static_cast<size_t>(operation)];
+        }
+
+        std::string toText() const
+        {
+            std::ostringstream out;
+            out << "operation calls cells total_ns\n";
+            for (size_t operation = 0; operation < OPERATION_NUM; operation++)
+            {
+                const auto &stats = operations[operation];
+                out << getOperationName(operation) << ' ' << stats.calls << ' ' << stats.cells << ' '
+                    << stats.totalNs << '\n';
+            }
+            out << "validation_failures " << validationFailures << '\n';
+            return out.str();
+        }
+
+        std::string toJson() const
+        {
+            std::ostringstream out;
+            out << "{\"operations\":{";
+            for (size_t operation = 0; operation < OPERATION_NUM; operation++)
+            {
+                const auto &stats = operations[operation];
+                out << (operation ? "," : "") << '"' << getOperationName(operation) << "\":{\"calls\":" << stats.calls
+                    << ",\"cells\":" << stats.cells << ",\"total_ns\":" << stats.totalNs << ",\"latency_log2_ns\":[";
+                for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+                {
+                    out << (bucket ? "," : "") << stats.latency[bucket];
+                }
+                out << "]}";
+            }
+            out << "},\"validation_failures\":" << validationFailures << '}';
+            return out.str();
+        }
+    };
+
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(LightOperation operation, uint64_t cells)
+            : operation_(operation), cells_(cells), start_(std::chrono::steady_clock::now())
+        {
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+        ~ScopedTimer()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            record(operation_, cells_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+
+    private:
+        LightOperation operation_;
+        uint64_t cells_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    static void record(LightOperation operation, uint64_t cells, uint64_t ns)
+    {
+        auto &shard = getLocalShard();
+        auto &stats = shard.operations[static_cast<size_t>(operation)];
+        increment(stats.calls, 1);
+        increment(stats.cells, cells);
+        increment(stats.totalNs, ns);
+
+        size_t bucket = 0;
+        while (bucket + 1 < LATENCY_BUCKETS && (ns >> bucket) != 0)
+        {
+            bucket++;
+        }
+        increment(stats.latency[bucket], 1);
+    }
+
+    static void recordValidationFailure()
+    {
+        increment(getLocalShard().validationFailures, 1);
+    }
+
+    static Snapshot snapshot()
+    {
+        Snapshot result;
+        std::lock_guard<std::mutex> lock(getRegistry().mutex);
+        for (const auto &shard : getRegistry().shards)
+        {
+            for (size_t operation = 0; operation < OPERATION_NUM; operation++)
+            {
+                const auto &from = shard->operations[operation];
+                auto &to = result.operations[operation];
+                to.calls += from.calls.load(std::memory_order_relaxed);
+                to.cells += from.cells.load(std::memory_order_relaxed);
+                to.totalNs += from.totalNs.load(std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+                {
+                    to.latency[bucket] += from.latency[bucket].load(std::memory_order_relaxed);
+                }
+            }
+            result.validationFailures += shard->validationFailures.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    // counts recorded concurrently with a reset may be lost
+    static void reset()
+    {
+        std::lock_guard<std::mutex> lock(getRegistry().mutex);
+        for (auto &shard : getRegistry().shards)
+        {
+            for (auto &stats : shard->operations)
+            {
+                stats.calls = 0;
+                stats.cells = 0;
+                stats.totalNs = 0;
+                for (auto &bucket : stats.latency)
+                {
+                    bucket = 0;
+                }
+            }
+            shard->validationFailures = 0;
+        }
+    }
+
+    static const char *getOperationName(size_t operation)
+    {
+        static const char *const names[OPERATION_NUM] = {"get_range", "set_range", "modify_range",
+                                                         "open_range", "close_range", "switch_range",
+                                                         "count_range", "sum_range", "apply_batch",
+                                                         "custom"};
+        return names[operation];
+    }
+
+private:
+    struct OperationCounters
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> cells{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> latency{};
+    };
+
+    struct Shard
+    {
+        std::array<OperationCounters, OPERATION_NUM> operations{};
+        std::atomic<uint64_t> validationFailures{0};
+    };
+
+    // shards outlive their threads so that counts of finished threads stay visible
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Shard>> shards;
+    };
+
+    static Registry &getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    static Shard &getLocalShard()
+    {
+        thread_local std::shared_ptr<Shard> shard = []() {
+            auto created = std::make_shared<Shard>();
+            std::lock_guard<std::mutex> lock(getRegistry().mutex);
+            getRegistry().shards.push_back(created);
+            return created;
+        }();
+        return *shard;
+    }
+
+    // only the owning thread writes a shard, so a relaxed load and store is enough
+    static void increment(std::atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
@@ -1,5 +1,13 @@
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
 #include "gtest/gtest.h"
+#include "weatherBatch.h"
 #include "weatherParser.h"
+#include "weatherScanner.h"
+#include "weatherSchema.h"
 
 using namespace Weather;
 
@@ -36,6 +44,13 @@ class WeatherParserFileOperation : public ::testing::Test {
 public:
     WeatherParserFileOperation() : parser_(DATA_FILE) {}
 
+    void SetUp() override
+    {
+        if (!std::ifstream(DATA_FILE)) {
+            GTEST_SKIP() << DATA_FILE << " is not available";
+        }
+    }
+
     WeatherParser parser_;
 };
 
@@ -49,6 +64,488 @@ TEST_F(WeatherParserFileOperation, getSmallestDay){
     EXPECT_EQ(result, 14);
 }
 
+class WeatherParserSidecarCache : public ::testing::Test {
+public:
+    void SetUp() override
+    {
+        dataFile_ = ::testing::TempDir() + "weather_sidecar_test.dat";
+        std::ofstream out(dataFile_, std::ios_base::trunc);
+        out << "  Dy MxT   MnT   AvT\n\n" << firstDataLine << '\n' << secondDataLine << '\n';
+    }
+
+    void TearDown() override
+    {
+        std::remove(dataFile_.c_str());
+        std::remove(WeatherCache::getSidecarPath(dataFile_).c_str());
+    }
+
+    WeatherCache::SourceStat getSourceStat() const
+    {
+        WeatherCache::SourceStat sourceStat;
+        EXPECT_TRUE(WeatherCache::getSourceStat(dataFile_, sourceStat));
+        return sourceStat;
+    }
+
+    std::string dataFile_;
+};
+
+TEST_F(WeatherParserSidecarCache, WriteSidecarAfterTextParse)
+{
+    WeatherParser parser(dataFile_, true);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 2);
+
+    WeatherCache cache(dataFile_);
+    ASSERT_TRUE(cache.load());
+    EXPECT_EQ(cache.getRowCount(), 2u);
+    EXPECT_EQ(cache.getDayNumbers()[1], 2);
+    EXPECT_EQ(cache.getMinTemperatures()[1], 79);
+    EXPECT_EQ(cache.getMaxTemperatures()[1], 63);
+}
+
+TEST_F(WeatherParserSidecarCache, UseValidSidecar)
+{
+    WeatherColumns columns;
+    columns.push_back(7, 50, 49);
+    ASSERT_TRUE(WeatherCache(dataFile_).store(columns, getSourceStat()));
+
+    WeatherParser parser(dataFile_, true);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 7);
+}
+
+TEST_F(WeatherParserSidecarCache, FollowAfterSidecar)
+{
+    WeatherColumns columns;
+    columns.push_back(7, 90, 10);
+    ASSERT_TRUE(WeatherCache(dataFile_).store(columns, getSourceStat()));
+
+    WeatherParser parser(dataFile_, true);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 7);
+    // the lines the sidecar covers are not read again
+    EXPECT_EQ(parser.pollAppendedData(), 7);
+
+    std::ofstream(dataFile_, std::ios_base::app) << "   3  50    45\n";
+    EXPECT_EQ(parser.pollAppendedData(), 3);
+}
+
+TEST_F(WeatherParserSidecarCache, SkipSidecarForUnfinishedLastLine)
+{
+    std::ofstream(dataFile_, std::ios_base::app) << "   3  50";
+    WeatherParser parser(dataFile_, true);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 3);
+    EXPECT_FALSE(WeatherCache(dataFile_).load());
+}
+
+TEST_F(WeatherParserSidecarCache, FallbackWhenSidecarIsStale)
+{
+    WeatherColumns columns;
+    columns.push_back(7, 50, 49);
+    ASSERT_TRUE(WeatherCache(dataFile_).store(columns, getSourceStat()));
+
+    std::ofstream(dataFile_, std::ios_base::app) << "   3  77    55    66\n";
+
+    WeatherParser parser(dataFile_, true);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 2);
+}
+
+TEST_F(WeatherParserSidecarCache, StaleWhenAppendedAfterSourceStat)
+{
+    auto sourceStat = getSourceStat();
+    std::ofstream(dataFile_, std::ios_base::app) << "   3  77    55    66\n";
+
+    WeatherColumns columns;
+    columns.push_back(7, 50, 49);
+    ASSERT_TRUE(WeatherCache(dataFile_).store(columns, sourceStat));
+    EXPECT_FALSE(WeatherCache(dataFile_).load());
+}
+
+TEST_F(WeatherParserSidecarCache, ConcurrentStoresKeepSidecarWhole)
+{
+    auto sourceStat = getSourceStat();
+    std::vector<std::thread> writers;
+    for (int writer = 1; writer <= 4; writer++) {
+        writers.emplace_back([this, writer, sourceStat]() {
+            WeatherColumns columns;
+            for (int row = 0; row < writer * 1000; row++) {
+                columns.push_back(writer, writer, writer);
+            }
+            for (int round = 0; round < 20; round++) {
+                EXPECT_TRUE(WeatherCache(dataFile_).store(columns, sourceStat));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    WeatherCache cache(dataFile_);
+    ASSERT_TRUE(cache.load());
+    auto writer = cache.getDayNumbers()[0];
+    EXPECT_EQ(cache.getRowCount(), static_cast<size_t>(writer) * 1000);
+    EXPECT_EQ(cache.getMaxTemperatures()[cache.getRowCount() - 1], writer);
+}
+
+TEST_F(WeatherParserSidecarCache, RejectCorruptRowCount)
+{
+    auto sourceStat = getSourceStat();
+    WeatherCache::SidecarHeader header{{'W', 'X', 'C', 'C'}, WeatherCache::VERSION, sourceStat.size, sourceStat.mtimeNs,
+                                       (uint64_t{1} << 62) + 1};
+    // 3 * rowCount * sizeof(int32_t) wraps around to the 12 bytes that follow
+    std::ofstream out(WeatherCache::getSidecarPath(dataFile_), std::ios_base::binary | std::ios_base::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write("\0\0\0\0\0\0\0\0\0\0\0\0", 12);
+    out.close();
+
+    EXPECT_FALSE(WeatherCache(dataFile_).load());
+}
+
+class WeatherParserFollowMode : public ::testing::Test {
+public:
+    void SetUp() override
+    {
+        dataFile_ = ::testing::TempDir() + "weather_follow_test.dat";
+        std::ofstream(dataFile_, std::ios_base::trunc) << "  Dy MxT   MnT   AvT\n\n";
+    }
+
+    void TearDown() override
+    {
+        std::remove(dataFile_.c_str());
+    }
+
+    void append(const std::string& content)
+    {
+        std::ofstream(dataFile_, std::ios_base::app) << content;
+    }
+
+    std::string dataFile_;
+};
+
+TEST_F(WeatherParserFollowMode, ParseOnlyAppendedLines)
+{
+    WeatherParser parser(dataFile_);
+    EXPECT_EQ(parser.pollAppendedData(), -1);
+
+    append(firstDataLine + '\n');
+    EXPECT_EQ(parser.pollAppendedData(), 1);
+
+    append(secondDataLine + '\n');
+    EXPECT_EQ(parser.pollAppendedData(), 2);
+}
+
+TEST_F(WeatherParserFollowMode, KeepPartialTrailingLine)
+{
+    WeatherParser parser(dataFile_);
+    append(firstDataLine + "\n   2  79    6");
+    EXPECT_EQ(parser.pollAppendedData(), 1);
+
+    append("3    71\n");
+    EXPECT_EQ(parser.pollAppendedData(), 2);
+}
+
+TEST_F(WeatherParserFollowMode, NotifyWhenSmallestSpreadChanges)
+{
+    WeatherParser parser(dataFile_);
+    std::vector<std::pair<int, int>> notifications;
+    parser.setSpreadChangedCallback([&notifications](int day, int spread) { notifications.emplace_back(day, spread); });
+
+    append(firstDataLine + '\n' + secondDataLine + '\n' + "   3  80    50    65\n");
+    parser.pollAppendedData();
+
+    ASSERT_EQ(notifications.size(), 2u);
+    EXPECT_EQ(notifications[0], std::make_pair(1, 29));
+    EXPECT_EQ(notifications[1], std::make_pair(2, 16));
+}
+
+TEST_F(WeatherParserFollowMode, WaitForAppend)
+{
+    WeatherParser parser(dataFile_);
+    parser.pollAppendedData();
+    EXPECT_FALSE(parser.waitForAppend(0));
+
+    append(firstDataLine + '\n');
+    EXPECT_TRUE(parser.waitForAppend(1000));
+    EXPECT_EQ(parser.pollAppendedData(), 1);
+}
+
+TEST_F(WeatherParserFollowMode, ContinueAfterFullParse)
+{
+    // the unfinished last line reads as day 2 with 7 and 9 until its last column arrives
+    append(firstDataLine + "\n   2  79");
+    WeatherParser parser(dataFile_);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 2);
+    EXPECT_EQ(parser.getSmallestTempSpread(), -2);
+
+    // rewriting parsed bytes in place is not seen, only what follows them is parsed
+    {
+        std::fstream file(dataFile_, std::ios_base::in | std::ios_base::out);
+        file.seekp(22);
+        file << "   9  50    50";
+    }
+    append("    63\n");
+    EXPECT_EQ(parser.pollAppendedData(), 2);
+    EXPECT_EQ(parser.getSmallestTempSpread(), 16);
+}
+
+TEST_F(WeatherParserFollowMode, ReplaceProvisionalTailWhenCompleted)
+{
+    append(firstDataLine + "\n   2  79");
+    WeatherParser parser(dataFile_);
+    EXPECT_EQ(parser.getSmallestTempSpreadDay(), 2);
+
+    append("0    10\n");
+    EXPECT_EQ(parser.pollAppendedData(), 1);
+    EXPECT_EQ(parser.getSmallestTempSpread(), 29);
+}
+
+TEST_F(WeatherParserFollowMode, RestartAfterTruncateOrReplace)
+{
+    append(firstDataLine + '\n' + secondDataLine + '\n');
+    WeatherParser parser(dataFile_);
+    EXPECT_EQ(parser.pollAppendedData(), 2);
+
+    std::ofstream(dataFile_, std::ios_base::trunc) << "header\n\n   7  88    59\n";
+    EXPECT_TRUE(parser.waitForAppend(0));
+    EXPECT_EQ(parser.pollAppendedData(), 7);
+    EXPECT_EQ(parser.getSmallestTempSpread(), 29);
+
+    const auto replacement = dataFile_ + ".new";
+    std::ofstream(replacement, std::ios_base::trunc) << "header\n\n   8  60    55\n   9  60    50\n";
+    ASSERT_EQ(std::rename(replacement.c_str(), dataFile_.c_str()), 0);
+    EXPECT_EQ(parser.pollAppendedData(), 8);
+    EXPECT_EQ(parser.getSmallestTempSpread(), 5);
+}
+
+TEST_F(WeatherParserFollowMode, MoveKeepsFollowState)
+{
+    WeatherParser parser(dataFile_);
+    parser.pollAppendedData();
+    EXPECT_FALSE(parser.waitForAppend(0));
+
+    WeatherParser moved(std::move(parser));
+    append(firstDataLine + '\n');
+    EXPECT_TRUE(moved.waitForAppend(1000));
+    EXPECT_EQ(moved.pollAppendedData(), 1);
+}
+
+TEST(WeatherParserBuffer, GetSmallestDayFromContent)
+{
+    WeatherParser parser;
+    EXPECT_EQ(parser.getSmallestTempSpreadDay("header\n\n" + firstDataLine + '\n' + secondDataLine), 2);
+    EXPECT_EQ(parser.getSmallestTempSpread(), 16);
+}
+
+class WeatherBatchProcessing : public ::testing::Test {
+public:
+    void TearDown() override
+    {
+        for (const auto& path : paths_) {
+            std::remove(path.c_str());
+        }
+    }
+
+    void addFile(const std::string& name, const std::string& content)
+    {
+        paths_.push_back(::testing::TempDir() + name);
+        std::ofstream(paths_.back(), std::ios_base::trunc) << "  Dy MxT   MnT   AvT\n\n" << content;
+    }
+
+    std::vector<std::string> paths_;
+};
+
+TEST_F(WeatherBatchProcessing, PerFileResultsAndGlobalBest)
+{
+    addFile("weather_batch_a.dat", firstDataLine + '\n' + secondDataLine + '\n');
+    addFile("weather_batch_b.dat", "   5  60    58    59\n   6  70    50    60\n");
+    addFile("weather_batch_c.dat", firstDataLine + '\n');
+    paths_.push_back(::testing::TempDir() + "weather_batch_missing.dat");
+
+    auto result = WeatherBatch(2).run(paths_);
+
+    ASSERT_EQ(result.files.size(), 4u);
+    EXPECT_EQ(result.files[0].day, 2);
+    EXPECT_EQ(result.files[1].day, 5);
+    EXPECT_EQ(result.files[2].day, 1);
+    EXPECT_FALSE(result.files[3].isRead);
+    EXPECT_EQ(result.bestFileIndex, 1);
+    EXPECT_EQ(result.bestDay, 5);
+    EXPECT_EQ(result.bestSpread, 2);
+}
+
+TEST_F(WeatherBatchProcessing, KeepGoingAfterUnparsableFile)
+{
+    addFile("weather_batch_overflow.dat", "99999999999  88  59\n");
+    addFile("weather_batch_good.dat", "   5  60    58    59\n");
+
+    auto result = WeatherBatch(1).run(paths_);
+
+    ASSERT_EQ(result.files.size(), 2u);
+    EXPECT_TRUE(result.files[0].isFailed);
+    EXPECT_FALSE(result.files[0].error.empty());
+    EXPECT_FALSE(result.files[1].isFailed);
+    EXPECT_EQ(result.bestFileIndex, 1);
+    EXPECT_EQ(result.bestDay, 5);
+}
+
+TEST(WeatherScannerTokenize, ParseDigits)
+{
+    const std::string digits = "123456789 ";
+    EXPECT_EQ(WeatherScanner::parseDigits(digits.c_str(), 1), 1u);
+    EXPECT_EQ(WeatherScanner::parseDigits(digits.c_str(), 3), 123u);
+    EXPECT_EQ(WeatherScanner::parseDigits(digits.c_str(), 8), 12345678u);
+    EXPECT_EQ(WeatherScanner::parseDigits(digits.c_str(), 9), 123456789u);
+}
+
+TEST(WeatherScannerTokenize, FindLineTerminator)
+{
+    const std::string data = std::string(70, ' ') + "\r\n";
+    EXPECT_EQ(WeatherScanner::findLineTerminator(data.data(), data.data() + data.size()), data.data() + 70);
+    EXPECT_EQ(WeatherScanner::findLineTerminator(data.data(), data.data() + 70), data.data() + 70);
+}
+
+TEST(WeatherScannerTokenize, AgreeWithRegex)
+{
+    WeatherParser parser;
+    const std::vector<std::string> lines = {
+        firstDataLine, secondDataLine, "   9  86    32*   59       6    61.5", "  mo  82.9  60.5  71.7    16",
+        "", "     ", "\t1\t2\t3", "12 3", "1234", "1 2x 3", "1 2 3x", "  26  97*   64    81", std::string(40, ' ') + "1 2 3",
+        "1 2 " + std::string(40, ' ') + "3", "123456789 2 3", "7 8 9"};
+
+    for (const auto& line : lines) {
+        int fields[3];
+        auto result = WeatherScanner::parseLeadingFields(line.data(), line.data() + line.size(), line.data() + line.size(), fields);
+        auto expected = parser.getWeatherDataFromLine(line);
+        if (result == WeatherScanner::FieldsResult::PARSED) {
+            ASSERT_TRUE(expected.has_value()) << line;
+            EXPECT_EQ(fields[0], expected->dayNumber) << line;
+            EXPECT_EQ(fields[1], expected->minTemperature) << line;
+            EXPECT_EQ(fields[2], expected->maxTemperature) << line;
+        } else if (result == WeatherScanner::FieldsResult::REJECTED) {
+            EXPECT_FALSE(expected.has_value()) << line;
+        }
+    }
+}
+
+TEST(WeatherParserBuffer, MatchRegexForIrregularLines)
+{
+    WeatherParser parser;
+    EXPECT_EQ(parser.getSmallestTempSpreadDay("\n\n  mo  82.9  60.5\n   4  50  40\n  123\n   5  90  30\r\n"), 1);
+    EXPECT_EQ(parser.getSmallestTempSpread(), -1);
+}
+
+TEST(WeatherSchemaParser, ParseWeatherDat)
+{
+    const std::string content = "  Dy MxT   MnT   AvT\n\n" + firstDataLine + '\n' + secondDataLine +
+                                "\n   9  86    32*   59\n  mo  82.9  60.5  71.7    16\n";
+
+    std::vector<ParserFor<WeatherDatSchema>::Record> records;
+    auto count = ParserFor<WeatherDatSchema>::parse(content, [&](const auto& record) { records.push_back(record); });
+    ASSERT_EQ(count, 3u);
+    EXPECT_EQ(records[0], std::make_tuple(1, 88, 59));
+    EXPECT_EQ(records[2], std::make_tuple(9, 86, 32));
+
+    WeatherParser parser;
+    auto best = std::min_element(records.begin(), records.end(), [](const auto& a, const auto& b) {
+        return std::get<1>(a) - std::get<2>(a) < std::get<1>(b) - std::get<2>(b);
+    });
+    EXPECT_EQ(std::get<0>(*best), parser.getSmallestTempSpreadDay(content));
+}
+
+struct StationExportSchema {
+    static constexpr size_t HEADER_LINES = 1;
+    static constexpr std::array<ColumnSpec, 3> COLUMNS = {
+        fixedWidthColumn(0, 6, ColumnType::INT), delimitedColumn(2, ColumnType::FLOAT),
+        fixedWidthColumn(20, 5, ColumnType::FLOAT)};
+};
+
+TEST(WeatherSchemaParser, ParseFixedWidthAndSkippedColumns)
+{
+    ParserFor<StationExportSchema>::Record record;
+    EXPECT_TRUE(ParserFor<StationExportSchema>::parseLine(" 10417 x -3.25  99  12.5 tail", record));
+    EXPECT_EQ(std::get<0>(record), 10417);
+    EXPECT_DOUBLE_EQ(std::get<1>(record), -3.25);
+    EXPECT_DOUBLE_EQ(std::get<2>(record), 12.5);
+
+    EXPECT_FALSE(ParserFor<StationExportSchema>::parseLine(" 10417 x n/a   99  12.5", record));
+    EXPECT_FALSE(ParserFor<StationExportSchema>::parseLine(" 10417 x 1.0", record));
+
+    ParserFor<WeatherDatSchema>::Record dayRecord;
+    EXPECT_FALSE(ParserFor<WeatherDatSchema>::parseLine("  99999999999  1  2", dayRecord));
+    EXPECT_TRUE(ParserFor<WeatherDatSchema>::parseLine("  2147483647  1  2", dayRecord));
+    EXPECT_EQ(std::get<0>(dayRecord), 2147483647);
+    EXPECT_EQ(ParserFor<StationExportSchema>::parse("id a t r p\n    1 a .5  0       7.", [](const auto&) {}), 1u);
+}
+
+TEST(WeatherSchemaParser, RoundFloatColumnsCorrectly)
+{
+    ParserFor<StationExportSchema>::Record record;
+    EXPECT_TRUE(ParserFor<StationExportSchema>::parseLine("     1 x 0.3   99   -0.1", record));
+    EXPECT_EQ(std::get<1>(record), 0.3);
+    EXPECT_EQ(std::get<2>(record), -0.1);
+
+    EXPECT_TRUE(ParserFor<StationExportSchema>::parseLine("     1 x 123456.789012345678", record));
+    EXPECT_EQ(std::get<1>(record), 123456.789012345678);
+    EXPECT_FALSE(ParserFor<StationExportSchema>::parseLine("     1 x inf", record));
+    EXPECT_FALSE(ParserFor<StationExportSchema>::parseLine("     1 x +1.5", record));
+}
+
+TEST(WeatherParserStats, CountLinesAndRejectReasons)
+{
+    if (!ParserStats::ENABLED) {
+        GTEST_SKIP() << "built without WEATHER_PARSER_STATS";
+    }
+
+    WeatherParser parser;
+    const std::string content = "header\n\n" + firstDataLine + "\n\n  mo  82.9  60.5\n   7 x\n" + secondDataLine + '\n';
+    parser.getSmallestTempSpreadDay(content);
+
+    const auto& stats = parser.getStats();
+    EXPECT_EQ(stats.getBytesRead(), content.size());
+    EXPECT_EQ(stats.getLinesSeen(), 5u);
+    EXPECT_EQ(stats.getLinesParsed(), 2u);
+    EXPECT_EQ(stats.getLinesRejected(), 3u);
+    EXPECT_EQ(stats.getLinesRejected(RejectReason::BLANK), 1u);
+    EXPECT_EQ(stats.getLinesRejected(RejectReason::NOT_NUMERIC), 1u);
+    EXPECT_EQ(stats.getLinesRejected(RejectReason::MALFORMED), 1u);
+
+    const auto& latency = stats.getLineLatencyHistogram();
+    EXPECT_EQ(std::accumulate(latency.begin(), latency.end(), uint64_t{0}), 1u);
+    EXPECT_GT(stats.getPhaseNs(ParsePhase::PARSE), 0u);
+    // the smallest spread is reduced while parsing, only the sidecar paths have a separate reduce
+    EXPECT_EQ(stats.getPhaseNs(ParsePhase::REDUCE), 0u);
+}
+
+TEST(WeatherParserStats, ExportFormats)
+{
+    ParserStats stats;
+    stats.addBytesRead(42);
+    stats.addLineRejected(RejectReason::BLANK);
+    stats.addLineLatency(100);
+
+    auto json = stats.toJson();
+    EXPECT_NE(json.find("\"bytes_read\":42"), std::string::npos);
+    EXPECT_NE(json.find("\"blank\":1"), std::string::npos);
+
+    auto prometheus = stats.toPrometheus();
+    EXPECT_NE(prometheus.find("weather_parser_bytes_read_total 42\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_lines_rejected_total{reason=\"blank\"} 1\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_bucket{le=\"128\"} 1\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_count 1\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_sum 100\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("# TYPE weather_parser_line_latency_ns histogram\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("# TYPE weather_parser_bytes_read_total counter\n"), std::string::npos);
+}
+
+TEST(WeatherParserStats, LatencyBucketIncludesUpperBound)
+{
+    ParserStats stats;
+    stats.addLineLatency(128);
+    stats.addLineLatency(129);
+
+    auto prometheus = stats.toPrometheus();
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_bucket{le=\"64\"} 0\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_bucket{le=\"128\"} 1\n"), std::string::npos);
+    EXPECT_NE(prometheus.find("weather_parser_line_latency_ns_bucket{le=\"256\"} 2\n"), std::string::npos);
+}
+
 // ? open data file
 // ? skip the first two line
 // ? fetch weather data from one line
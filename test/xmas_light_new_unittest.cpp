@@ -1,5 +1,20 @@
 #include "gtest/gtest.h"
 #include "xmas_light_new.h"
+#include "xmas_light_export.h"
+#include "xmas_light_journal.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+static LightManager::Range getRandomRange(std::mt19937 &random)
+{
+    std::uniform_int_distribution<uint> position(0, LIGHT_NUM - 1);
+    auto x = std::minmax({position(random), position(random)});
+    auto y = std::minmax({position(random), position(random)});
+    return {{x.first, y.first}, {x.second, y.second}};
+}
 
 TEST(BasicOperations, GetLightByPosition)
 {
@@ -190,4 +205,307 @@ TEST(CountOperations, CountOpenLight)
 
     auto count = mgr.countOpenLight();
     EXPECT_EQ(count, 5);
-}
\ No newline at end of file
+}
+
+TEST(CountOperations, SumBrightnessInRange)
+{
+    LightManager mgr;
+
+    mgr.openLightWithRange({0, 0}, {99, 99});
+    mgr.switchLightWithRange({0, 0}, {9, 999});
+    mgr.closeLightWithRange({0, 0}, {0, 0});
+
+    EXPECT_EQ(mgr.countOpenLightInRange({{0, 0}, {999, 999}}), 10 * 1000 + 90 * 100);
+    EXPECT_EQ(mgr.sumBrightnessInRange({{0, 0}, {999, 999}}), 10000 + 20 * 1000 - 1);
+    EXPECT_EQ(mgr.sumBrightnessInRange({{0, 0}, {0, 1}}), 2 + 3);
+    EXPECT_EQ(mgr.countBrightness(), mgr.sumBrightnessInRange({{0, 0}, {999, 999}}));
+}
+
+TEST(CountOperations, SumBrightnessInRangeMatchScan)
+{
+    LightManager mgr;
+    std::mt19937 random(7);
+
+    for (int step = 0; step < 20; step++)
+    {
+        auto range = getRandomRange(random);
+        switch (step % 4)
+        {
+        case 0:
+            mgr.openLightWithRange(range.start, range.end);
+            break;
+        case 1:
+            mgr.switchLightWithRange(range.start, range.end);
+            break;
+        case 2:
+            mgr.closeLightWithRange(range.start, range.end);
+            break;
+        default:
+            mgr.setLightStateWithRange(range, step);
+        }
+
+        auto query = getRandomRange(random);
+        auto states = mgr.getLightStateWithRange(query);
+        uint sum = 0;
+        for (auto state : states)
+        {
+            sum += state;
+        }
+        EXPECT_EQ(mgr.sumBrightnessInRange(query), sum);
+        EXPECT_EQ(mgr.countOpenLightInRange(query),
+                  std::count_if(states.begin(), states.end(), [](uint state) { return state >= LightBrightness::OPEN; }));
+    }
+}
+
+TEST(HistogramOperations, TrackBrightnessLevels)
+{
+    LightManager mgr;
+
+    mgr.openLightWithRange({0, 0}, {9, 9});
+    mgr.switchLightWithRange({0, 0}, {0, 9});
+    mgr.setLightState(999, 999, 1000u);
+    mgr.modifyLightState(999, 999, 5);
+
+    const auto &histogram = mgr.getBrightnessHistogram();
+    EXPECT_EQ(histogram.getTotal(), LIGHT_NUM * LIGHT_NUM);
+    EXPECT_EQ(histogram.getCount(0), LIGHT_NUM * LIGHT_NUM - 101);
+    EXPECT_EQ(histogram.getCount(1), 90u);
+    EXPECT_EQ(histogram.getCount(3), 10u);
+    EXPECT_EQ(histogram.getCount(MAX_BRIGHTNESS), 1u);
+}
+
+TEST(HistogramOperations, Quantile)
+{
+    LightManager mgr;
+
+    mgr.setLightStateWithRange({0, 0}, {499, 999}, 10u);
+    mgr.setLightStateWithRange({500, 0}, {989, 999}, 20u);
+    mgr.setLightStateWithRange({990, 0}, {999, 999}, 1000u);
+
+    const auto &histogram = mgr.getBrightnessHistogram();
+    EXPECT_EQ(histogram.getQuantile(0.0), 10u);
+    EXPECT_EQ(histogram.getMedian(), 10u);
+    EXPECT_EQ(histogram.getQuantile(0.51), 20u);
+    EXPECT_EQ(histogram.getQuantile(0.99), 20u);
+    EXPECT_EQ(histogram.getQuantile(0.995), 1000u);
+    EXPECT_THROW(histogram.getQuantile(1.5), std::out_of_range);
+}
+
+TEST(HistogramOperations, Merge)
+{
+    BrightnessHistogram first;
+    BrightnessHistogram second;
+    first.add(5, 3);
+    second.add(5);
+    second.add(7, 2);
+
+    first.merge(second);
+    EXPECT_EQ(first.getTotal(), 6u);
+    EXPECT_EQ(first.getCount(5), 4u);
+    EXPECT_EQ(first.getCount(7), 2u);
+    EXPECT_EQ(first.getQuantile(0.9), 7u);
+}
+
+TEST(StatsOperations, RecordRangeOperations)
+{
+#ifndef XMAS_LIGHT_STATS
+    GTEST_SKIP() << "built without XMAS_LIGHT_STATS";
+#endif
+    LightManager mgr;
+    LightOpStats::reset();
+
+    mgr.openLightWithRange({0, 0}, {9, 9});
+    mgr.switchLightWithRange({0, 0}, {0, 9});
+    mgr.sumBrightnessInRange({{0, 0}, {1, 1}});
+    EXPECT_THROW(mgr.openLightWithRange({0, 0}, {0, 1000}), std::out_of_range);
+
+    auto snapshot = LightOpStats::snapshot();
+    EXPECT_EQ(snapshot[LightOperation::OPEN_RANGE].calls, 1u);
+    EXPECT_EQ(snapshot[LightOperation::OPEN_RANGE].cells, 100u);
+    EXPECT_EQ(snapshot[LightOperation::SWITCH_RANGE].cells, 10u);
+    EXPECT_EQ(snapshot[LightOperation::SUM_RANGE].calls, 1u);
+    EXPECT_EQ(snapshot[LightOperation::SET_RANGE].calls, 0u);
+    EXPECT_EQ(snapshot.validationFailures, 1u);
+}
+
+TEST(StatsOperations, MergeThreadsAndExport)
+{
+    LightOpStats::reset();
+    std::thread worker([]() {
+        LightOpStats::record(LightOperation::CUSTOM, 5, 100);
+    });
+    worker.join();
+    LightOpStats::record(LightOperation::CUSTOM, 7, 1);
+
+    auto snapshot = LightOpStats::snapshot();
+    EXPECT_EQ(snapshot[LightOperation::CUSTOM].calls, 2u);
+    EXPECT_EQ(snapshot[LightOperation::CUSTOM].cells, 12u);
+    EXPECT_EQ(snapshot[LightOperation::CUSTOM].latency[1], 1u);
+    EXPECT_EQ(snapshot[LightOperation::CUSTOM].latency[7], 1u);
+    EXPECT_NE(snapshot.toText().find("custom 2 12 101\n"), std::string::npos);
+    EXPECT_NE(snapshot.toJson().find("\"custom\":{\"calls\":2,\"cells\":12,\"total_ns\":101,"), std::string::npos);
+}
+
+TEST(JournalOperations, UndoRestoresClampedBrightness)
+{
+    auto mgr = std::make_unique<LightManager>();
+    mgr->setLightState(5, 5, 1000u);
+    LightJournal<LightManager> journal(*mgr, 2);
+
+    journal.apply({LightManager::Operation::OPEN, {{0, 0}, {9, 9}}});
+    journal.apply({LightManager::Operation::CLOSE, {{0, 0}, {0, 9}}});
+    journal.apply({LightManager::Operation::CLOSE, {{0, 0}, {0, 9}}});
+    journal.apply({LightManager::Operation::SWITCH, {{5, 5}, {6, 6}}});
+    journal.apply({LightManager::Operation::SET, {{1, 1}, {2, 2}}, 7u});
+    EXPECT_EQ(mgr->getLightState(0, 0), 0u);
+    EXPECT_EQ(mgr->getLightState(5, 5), MAX_BRIGHTNESS);
+    EXPECT_EQ(mgr->getLightState(6, 6), 3u);
+    EXPECT_EQ(mgr->getLightState(1, 1), 7u);
+
+    journal.undo(3);
+    EXPECT_EQ(journal.size(), 2u);
+    EXPECT_EQ(mgr->getLightState(0, 0), 0u);
+    EXPECT_EQ(mgr->getLightState(5, 5), MAX_BRIGHTNESS);
+    EXPECT_EQ(mgr->getLightState(6, 6), 1u);
+    EXPECT_EQ(mgr->getLightState(1, 1), 1u);
+
+    journal.undo(2);
+    EXPECT_EQ(mgr->getLightState(0, 0), 0u);
+    EXPECT_EQ(mgr->getLightState(5, 5), MAX_BRIGHTNESS);
+    EXPECT_EQ(mgr->countBrightness(), MAX_BRIGHTNESS);
+    EXPECT_EQ(mgr->getBrightnessHistogram().getCount(MAX_BRIGHTNESS), 1u);
+    EXPECT_THROW(journal.undo(), std::out_of_range);
+}
+
+TEST(JournalOperations, StateAtInstructionIndex)
+{
+    auto mgr = std::make_unique<LightManager>();
+    LightJournal<LightManager> journal(*mgr, 3);
+    std::mt19937 random(11);
+
+    std::vector<uint> brightnessAfter{0};
+    for (int step = 0; step < 10; step++)
+    {
+        auto operation = static_cast<LightManager::Operation>(step % 4);
+        journal.apply({operation, getRandomRange(random), static_cast<uint>(step)});
+        brightnessAfter.push_back(mgr->countBrightness());
+    }
+
+    for (size_t index = 0; index <= journal.size(); index++)
+    {
+        EXPECT_EQ(journal.getStateAt(index)->countBrightness(), brightnessAfter[index]);
+    }
+    EXPECT_THROW(journal.getStateAt(11), std::out_of_range);
+
+    journal.undo(4);
+    EXPECT_EQ(mgr->countBrightness(), brightnessAfter[6]);
+    EXPECT_EQ(journal.getStateAt(6)->countBrightness(), brightnessAfter[6]);
+}
+
+TEST(BatchOperations, MatchSequentialExecution)
+{
+    auto sequential = std::make_unique<LightManager>();
+    auto batched = std::make_unique<LightManager>();
+    std::mt19937 random(9);
+
+    // mostly closing, so that brightness gets clamped at zero along the way
+    const LightManager::Operation operations[] = {LightManager::Operation::CLOSE, LightManager::Operation::SWITCH,
+                                                  LightManager::Operation::CLOSE, LightManager::Operation::OPEN,
+                                                  LightManager::Operation::CLOSE, LightManager::Operation::SET};
+    std::vector<LightManager::Instruction> instructions;
+    for (uint step = 0; step < 60; step++)
+    {
+        instructions.push_back({operations[step % 6], getRandomRange(random), step});
+        sequential->apply(instructions.back());
+    }
+    batched->applyBatch(instructions, 7);
+
+    EXPECT_EQ(std::memcmp(&batched->getLightGrid(), &sequential->getLightGrid(), sizeof(LightManager::LightGrid)), 0);
+    EXPECT_EQ(batched->countBrightness(), sequential->countBrightness());
+    EXPECT_EQ(batched->sumBrightnessInRange({{1, 2}, {800, 999}}), sequential->sumBrightnessInRange({{1, 2}, {800, 999}}));
+    EXPECT_EQ(batched->getBrightnessHistogram().getMedian(), sequential->getBrightnessHistogram().getMedian());
+}
+
+class FrameExportOperations : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        file_ = std::tmpfile();
+        ASSERT_NE(file_, nullptr);
+    }
+
+    void TearDown() override
+    {
+        std::fclose(file_);
+    }
+
+    std::string readOutput()
+    {
+        std::string content(static_cast<size_t>(::lseek(fileno(file_), 0, SEEK_END)), '\0');
+        EXPECT_EQ(::pread(fileno(file_), &content[0], content.size(), 0), static_cast<ssize_t>(content.size()));
+        return content;
+    }
+
+    std::FILE *file_ = nullptr;
+};
+
+TEST_F(FrameExportOperations, WritePgm)
+{
+    auto mgr = std::make_unique<LightManager>();
+    mgr->setLightState(0, 1, MAX_BRIGHTNESS);
+    mgr->setLightState(1, 0, MAX_BRIGHTNESS / 2);
+
+    LightFrameExporter<LightManager>(fileno(file_)).writePgm(*mgr);
+
+    auto content = readOutput();
+    const std::string header = "P5\n1000 1000\n65535\n";
+    ASSERT_EQ(content.size(), header.size() + 2 * LIGHT_NUM * LIGHT_NUM);
+    EXPECT_EQ(content.substr(0, header.size()), header);
+    auto sample = [&](uint x, uint y) {
+        auto offset = header.size() + 2 * (x * LIGHT_NUM + y);
+        return static_cast<unsigned char>(content[offset]) << 8 | static_cast<unsigned char>(content[offset + 1]);
+    };
+    EXPECT_EQ(sample(0, 0), 0);
+    EXPECT_EQ(sample(0, 1), 65535);
+    EXPECT_EQ(sample(1, 0), 32767);
+}
+
+TEST_F(FrameExportOperations, WriteKeyframeAndDeltaFrame)
+{
+    using Exporter = LightFrameExporter<LightManager>;
+    auto mgr = std::make_unique<LightManager>();
+    Exporter exporter(fileno(file_));
+
+    exporter.writeDeltaFrame(*mgr);
+    mgr->openLightWithRange({3, 0}, {4, 9});
+    exporter.writeDeltaFrame(*mgr);
+    exporter.writeDeltaFrame(*mgr);
+
+    auto content = readOutput();
+    const size_t rowBytes = LIGHT_NUM * sizeof(LightBrightness);
+    const size_t keyframeSize = sizeof(Exporter::FrameHeader) + LIGHT_NUM * rowBytes;
+    const size_t deltaSize = sizeof(Exporter::FrameHeader) + 2 * (sizeof(uint32_t) + rowBytes);
+    ASSERT_EQ(content.size(), keyframeSize + deltaSize + sizeof(Exporter::FrameHeader));
+
+    Exporter::FrameHeader header;
+    std::memcpy(&header, content.data(), sizeof(header));
+    EXPECT_EQ(header.flags, Exporter::FLAG_KEYFRAME);
+    EXPECT_EQ(header.rowCount, LIGHT_NUM);
+
+    std::memcpy(&header, content.data() + keyframeSize, sizeof(header));
+    EXPECT_EQ(header.flags, 0u);
+    EXPECT_EQ(header.rowCount, 2u);
+    EXPECT_EQ(header.frameNumber, 1u);
+
+    uint32_t row;
+    LightBrightness light;
+    std::memcpy(&row, content.data() + keyframeSize + sizeof(header), sizeof(row));
+    std::memcpy(&light, content.data() + keyframeSize + sizeof(header) + sizeof(row) + 9 * sizeof(light), sizeof(light));
+    EXPECT_EQ(row, 3u);
+    EXPECT_EQ(light, LightBrightness::OPEN);
+
+    std::memcpy(&header, content.data() + keyframeSize + deltaSize, sizeof(header));
+    EXPECT_EQ(header.rowCount, 0u);
+    EXPECT_EQ(exporter.getFrameNumber(), 3u);
+}
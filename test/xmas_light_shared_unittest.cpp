@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "xmas_light_shared.h"
+
+#include <thread>
+#include <vector>
+
+class SharedGridOperations : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        name_ = "/xmas_light_shared_ut_" + std::to_string(::getpid());
+        SharedLightGrid::unlink(name_);
+    }
+
+    void TearDown() override
+    {
+        SharedLightGrid::unlink(name_);
+    }
+
+    std::string name_;
+};
+
+TEST_F(SharedGridOperations, AttachSeesCreatorUpdates)
+{
+    SharedLightGrid creator(name_, SharedLightGrid::OpenMode::CREATE);
+    SharedLightGrid attached(name_, SharedLightGrid::OpenMode::ATTACH);
+    EXPECT_EQ(attached.getGridSize(), 1000u);
+
+    creator.openLightWithRange({0, 60}, {1, 70});
+    attached.switchLightWithRange({0, 65}, {0, 65});
+    creator.modifyBrightnessWithRange({5, 5}, {5, 6}, 3);
+    attached.modifyBrightnessWithRange({5, 6}, {5, 6}, -5);
+
+    EXPECT_TRUE(attached.isOpen(1, 60));
+    EXPECT_FALSE(creator.isOpen(0, 65));
+    EXPECT_FALSE(attached.isOpen(0, 71));
+    EXPECT_EQ(creator.countOpenLight(), 21u);
+    EXPECT_EQ(attached.getBrightness(5, 5), 3u);
+    EXPECT_EQ(creator.getBrightness(5, 6), 0u);
+
+    attached.closeLightWithRange({0, 0}, {999, 999});
+    EXPECT_EQ(creator.countOpenLight(), 0u);
+}
+
+TEST_F(SharedGridOperations, RejectInvalidSegment)
+{
+    EXPECT_THROW(SharedLightGrid(name_, SharedLightGrid::OpenMode::ATTACH), std::system_error);
+
+    SharedLightGrid creator(name_, SharedLightGrid::OpenMode::CREATE, 10);
+    EXPECT_THROW(SharedLightGrid(name_, SharedLightGrid::OpenMode::CREATE), std::system_error);
+    EXPECT_THROW(creator.openLightWithRange({0, 0}, {0, 10}), std::out_of_range);
+}
+
+TEST_F(SharedGridOperations, ConcurrentRangeOperations)
+{
+    SharedLightGrid creator(name_, SharedLightGrid::OpenMode::CREATE);
+    creator.setBrightnessWithRange({0, 0}, {9, 99}, 500);
+
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < 4; worker++)
+    {
+        workers.emplace_back([this]() {
+            SharedLightGrid grid(name_, SharedLightGrid::OpenMode::ATTACH);
+            for (int round = 0; round < 50; round++)
+            {
+                grid.switchLightWithRange({0, 0}, {9, 99});
+                grid.modifyBrightnessWithRange({0, 0}, {9, 99}, 2);
+                grid.modifyBrightnessWithRange({0, 0}, {9, 99}, -1);
+            }
+        });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    EXPECT_EQ(creator.countOpenLight(), 0u);
+    EXPECT_EQ(creator.countBrightness(), 1000u * 700);
+}
@@ -1,5 +1,18 @@
 #include "gtest/gtest.h"
 #include "xmas_light.h"
+#include "xmas_light_export.h"
+#include "xmas_light_journal.h"
+
+#include <cstdio>
+#include <random>
+
+static LightManager::Range getRandomRange(std::mt19937 &random)
+{
+    std::uniform_int_distribution<uint> position(0, LIGHT_NUM - 1);
+    auto x = std::minmax({position(random), position(random)});
+    auto y = std::minmax({position(random), position(random)});
+    return {{x.first, y.first}, {x.second, y.second}};
+}
 
 TEST(BasicOperations, GetLightByPosition)
 {
@@ -182,4 +195,110 @@ TEST(CountOperations, CountOpenLight)
 
     auto count = mgr.countOpenLight();
     EXPECT_EQ(count, 5);
-}
\ No newline at end of file
+}
+
+TEST(CountOperations, CountOpenLightInRange)
+{
+    LightManager mgr;
+
+    mgr.openLightWithRange({10, 10}, {99, 99});
+    mgr.switchLightWithRange({50, 0}, {59, 999});
+    mgr.closeLight(20, 20);
+
+    EXPECT_EQ(mgr.countOpenLightInRange({{0, 0}, {999, 999}}), 90 * 90 - 10 * 90 + 10 * 910 - 1);
+    EXPECT_EQ(mgr.countOpenLightInRange({{10, 10}, {49, 99}}), 40 * 90 - 1);
+    EXPECT_EQ(mgr.countOpenLightInRange({{20, 20}, {20, 20}}), 0);
+    EXPECT_EQ(mgr.sumBrightnessInRange({{50, 100}, {59, 199}}), 1000);
+}
+
+TEST(CountOperations, CountOpenLightInRangeMatchScan)
+{
+    LightManager mgr;
+    std::mt19937 random(42);
+
+    for (int step = 0; step < 20; step++)
+    {
+        auto range = getRandomRange(random);
+        if (step % 2 == 0)
+        {
+            mgr.switchLightWithRange(range.start, range.end);
+        }
+        else
+        {
+            mgr.setLightStateWithRange(range, step % 3 ? LightState::OPEN : LightState::CLOSE);
+        }
+
+        auto query = getRandomRange(random);
+        auto states = mgr.getLightStateWithRange(query);
+        EXPECT_EQ(mgr.countOpenLightInRange(query), std::count(states.begin(), states.end(), LightState::OPEN));
+    }
+}
+
+TEST(JournalOperations, UndoAndStateAtInstructionIndex)
+{
+    auto mgr = std::make_unique<LightManager>();
+    LightJournal<LightManager> journal(*mgr, 2);
+
+    journal.apply({LightManager::Operation::OPEN, {{0, 0}, {9, 9}}});
+    journal.apply({LightManager::Operation::SWITCH, {{0, 0}, {19, 0}}});
+    journal.apply({LightManager::Operation::SET, {{0, 0}, {0, 9}}, LightState::CLOSE});
+    EXPECT_EQ(mgr->countOpenLight(), 100 - 10 + 10 - 9);
+
+    EXPECT_EQ(journal.getStateAt(0)->countOpenLight(), 0);
+    EXPECT_EQ(journal.getStateAt(1)->countOpenLight(), 100);
+    EXPECT_EQ(journal.getStateAt(2)->countOpenLight(), 100);
+
+    journal.undo();
+    EXPECT_EQ(mgr->countOpenLight(), 100);
+    EXPECT_EQ(mgr->getLightState(0, 0), LightState::CLOSE);
+    EXPECT_EQ(mgr->getLightState(0, 1), LightState::OPEN);
+
+    journal.undo(2);
+    EXPECT_EQ(mgr->countOpenLight(), 0);
+}
+
+TEST(BatchOperations, MatchSequentialExecution)
+{
+    auto sequential = std::make_unique<LightManager>();
+    auto batched = std::make_unique<LightManager>();
+    std::mt19937 random(5);
+
+    std::vector<LightManager::Instruction> instructions;
+    for (int step = 0; step < 40; step++)
+    {
+        auto state = step % 3 ? LightState::OPEN : LightState::CLOSE;
+        instructions.push_back({static_cast<LightManager::Operation>(step % 4), getRandomRange(random), state});
+        sequential->apply(instructions.back());
+    }
+    batched->applyBatch(instructions, 16);
+
+    EXPECT_EQ(batched->getLightGrid(), sequential->getLightGrid());
+    EXPECT_EQ(batched->countOpenLightInRange({3, 5}, {990, 700}), sequential->countOpenLightInRange({3, 5}, {990, 700}));
+
+    instructions.push_back({LightManager::Operation::OPEN, {{0, 0}, {LIGHT_NUM, 0}}});
+    EXPECT_THROW(batched->applyBatch(instructions), std::out_of_range);
+    EXPECT_EQ(batched->getLightGrid(), sequential->getLightGrid());
+}
+
+TEST(FrameExportOperations, WritePbm)
+{
+    auto mgr = std::make_unique<LightManager>();
+    mgr->openLightWithRange({0, 0}, {0, 8});
+    mgr->openLight(1, 999);
+
+    auto *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    LightFrameExporter<LightManager>(fileno(file)).writePbm(*mgr);
+
+    std::string content(static_cast<size_t>(::lseek(fileno(file), 0, SEEK_END)), '\0');
+    ASSERT_EQ(::pread(fileno(file), &content[0], content.size(), 0), static_cast<ssize_t>(content.size()));
+    std::fclose(file);
+
+    const std::string header = "P4\n1000 1000\n";
+    const size_t rowBytes = 125;
+    ASSERT_EQ(content.size(), header.size() + rowBytes * LIGHT_NUM);
+    EXPECT_EQ(static_cast<unsigned char>(content[header.size()]), 0xFF);
+    EXPECT_EQ(static_cast<unsigned char>(content[header.size() + 1]), 0x80);
+    EXPECT_EQ(static_cast<unsigned char>(content[header.size() + 2]), 0x00);
+    EXPECT_EQ(static_cast<unsigned char>(content[header.size() + 2 * rowBytes - 1]), 0x01);
+}